@@ -0,0 +1,16 @@
+#include "Executor.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "ThreadPool.h"
+
+namespace scorpion {
+
+Executor &DefaultExecutor() {
+    // a single blocking callback must not stall every component sharing it
+    static ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+} // namespace scorpion
@@ -0,0 +1,49 @@
+/**
+ * Where a component runs its callbacks, so that components share threads instead of each starting its own.
+ *
+ * Key Features:
+ * 0. Execute() hands a callback over, false if it was not accepted (it may block while the executor is full).
+ * 1. DefaultExecutor() is one process-wide ThreadPool sized to the hardware, created on first use.
+ * 2. InlineExecutor runs the callback on the calling thread (tests, or callbacks cheap enough not to hop).
+ *
+ */
+
+#pragma once
+
+#include "InplaceFunction.h"
+
+namespace scorpion {
+
+class Executor {
+public:
+    using Callback = InplaceFunction<int()>;
+
+public:
+    virtual ~Executor() = default;
+
+public:
+    virtual bool Execute(Callback cb) = 0;
+
+    // how many callbacks may run at the same time
+    virtual unsigned Concurrency() const = 0;
+};
+
+class InlineExecutor : public Executor {
+public:
+    bool Execute(Callback cb) override {
+        if (!cb) {
+            return false;
+        }
+        cb();
+        return true;
+    }
+
+    unsigned Concurrency() const override {
+        return 1;
+    }
+};
+
+// std::thread::hardware_concurrency() threads (at least 2), lives until the end of the process
+Executor &DefaultExecutor();
+
+} // namespace scorpion
@@ -0,0 +1,300 @@
+/**
+ * Data parallel loops on ThreadPool or the AsyncTaskPool managers.
+ *
+ * Key Features:
+ * 0. ParallelFor / ParallelTransform / ParallelReduce / ParallelSort take the pool as their first argument.
+ * 1. Guided scheduling: every participant claims [next, next + max(grain, remaining / 2P)) from a shared
+ *    atomic cursor, big chunks first and small ones at the tail to balance the load; grain 0 picks one
+ *    from the range size.
+ * 2. The calling thread is a participant: it works until the range is exhausted and only waits for the
+ *    chunks still running elsewhere, so a busy (or nested) pool degrades to a serial loop, not a deadlock.
+ * 3. The first exception cancels the chunks which did not start and is rethrown to the caller.
+ * 4. ParallelReduce requires an associative and commutative op, the partial results are combined
+ *    in no particular order.
+ * 5. ParallelSort sorts blocks in parallel, then merges them in rounds where every merge is split
+ *    into independent pieces (value_type must be default constructible).
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "AsyncTaskPool.h"
+#include "Futex.h"
+#include "ThreadPool.h"
+
+namespace scorpion {
+
+namespace detail {
+
+inline unsigned Participants(const ThreadPool &pool) {
+    return pool.Size() + 1;
+}
+
+template <typename QUEUE>
+unsigned Participants(const Manager<Task, QUEUE> &pool) {
+    return pool.Size() + 1;
+}
+
+// never blocks: a worker spawning into its own full pool would wait for a queue only workers drain
+inline bool Spawn(ThreadPool &pool, unsigned, InplaceFunction<int()> fn) {
+    return pool.TryPush(std::move(fn));
+}
+
+template <typename QUEUE>
+bool Spawn(Manager<Task, QUEUE> &pool, unsigned uid, Task::Func fn) {
+    return pool.Submit(uid, Task(uid, std::chrono::steady_clock::now(), std::move(fn)));
+}
+
+// shared by the participants of one loop, helpers hold it until they return
+template <typename Body>
+class ParallelRange {
+public:
+    ParallelRange(size_t first, size_t last, size_t grain, unsigned participants, Body &body)
+        : _last(last)
+        , _grain(grain)
+        , _participants(participants)
+        , _body(body)
+        , _next(first)
+        , _left(last - first)
+        , _finished(0) {}
+
+public:
+    // claim chunks until the range is exhausted, slot identifies the participant
+    void Work(unsigned slot) {
+        size_t begin = 0;
+        size_t end = 0;
+        while (claim(begin, end)) {
+            try {
+                _body(begin, end, slot);
+            } catch (...) {
+                abort(std::current_exception());
+            }
+            done(end - begin);
+        }
+    }
+
+    // wait for the chunks running on other threads, rethrow the first exception
+    void Join() {
+        while (_finished.load(std::memory_order_acquire) == 0) {
+            FutexWait(&_finished, 0);
+        }
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+    }
+
+private:
+    bool claim(size_t &begin, size_t &end) {
+        auto next = _next.load(std::memory_order_relaxed);
+        while (next < _last) {
+            auto chunk = std::max(_grain, (_last - next) / (2 * _participants));
+            auto stop = std::min(_last, next + chunk);
+            if (_next.compare_exchange_weak(next, stop, std::memory_order_relaxed)) {
+                begin = next;
+                end = stop;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void abort(std::exception_ptr error) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_error) {
+                _error = std::move(error);
+            }
+        }
+        // the unclaimed tail will never run, count it as done
+        auto next = _next.exchange(_last, std::memory_order_relaxed);
+        if (next < _last) {
+            done(_last - next);
+        }
+    }
+
+    void done(size_t count) {
+        if (_left.fetch_sub(count, std::memory_order_acq_rel) == count) {
+            _finished.store(1, std::memory_order_release);
+            FutexWakeAll(&_finished);
+        }
+    }
+
+private:
+    const size_t _last;
+    const size_t _grain;
+    const size_t _participants;
+    Body &_body; // only touched after a successful claim, the caller is still in Join() then
+    std::atomic<size_t> _next;
+    std::atomic<size_t> _left;
+    std::atomic<uint32_t> _finished;
+    std::mutex _mutex;
+    std::exception_ptr _error;
+};
+
+// call body(begin, end, slot) on disjoint chunks of [first, last), slot < participants
+template <typename Pool, typename Body>
+void ParallelRun(Pool &pool, size_t first, size_t last, size_t grain, unsigned participants, Body body) {
+    if (first >= last) {
+        return;
+    }
+    auto count = last - first;
+    if (grain == 0) {
+        grain = std::max<size_t>(1, count / ((size_t)participants * 32));
+    }
+    participants = (unsigned)std::min<size_t>(participants, (count + grain - 1) / grain);
+    if (participants <= 1) {
+        body(first, last, 0);
+        return;
+    }
+    auto range = std::make_shared<ParallelRange<Body>>(first, last, grain, participants, body);
+    for (unsigned slot = 1; slot < participants; ++slot) {
+        // a rejected helper is fine, the others (and the caller) take its share
+        Spawn(pool, slot, [range, slot]() {
+            range->Work(slot);
+            return 0;
+        });
+    }
+    range->Work(0);
+    range->Join();
+}
+
+// one round of merging sorted runs of width w from src into dst, every merge split into pieces
+template <typename Pool, typename Src, typename Dst, typename Compare>
+void MergeRound(Pool &pool, Src src, Dst dst, size_t n, size_t w, unsigned participants, Compare &comp) {
+    auto pairs = (n + 2 * w - 1) / (2 * w);
+    auto pieces = std::max<size_t>(1, (2 * (size_t)participants + pairs - 1) / pairs);
+    // split points are computed before any element is moved
+    std::vector<size_t> splits(pairs * (pieces + 1));
+    ParallelRun(pool, 0, pairs, 1, participants, [&](size_t begin, size_t end, unsigned) {
+        for (auto p = begin; p < end; ++p) {
+            auto lo = p * 2 * w;
+            auto mid = std::min(n, lo + w);
+            auto hi = std::min(n, lo + 2 * w);
+            auto at = &splits[p * (pieces + 1)];
+            at[0] = mid;
+            at[pieces] = hi;
+            for (size_t j = 1; j < pieces; ++j) {
+                auto a = lo + j * (mid - lo) / pieces;
+                at[j] = (size_t)(std::lower_bound(src + (std::ptrdiff_t)mid, src + (std::ptrdiff_t)hi,
+                                                  src[(std::ptrdiff_t)a], comp) -
+                                 src);
+            }
+        }
+    });
+    ParallelRun(pool, 0, pairs * pieces, 1, participants, [&](size_t begin, size_t end, unsigned) {
+        for (auto t = begin; t < end; ++t) {
+            auto p = t / pieces;
+            auto j = t % pieces;
+            auto lo = p * 2 * w;
+            auto mid = std::min(n, lo + w);
+            auto a0 = lo + j * (mid - lo) / pieces;
+            auto a1 = lo + (j + 1) * (mid - lo) / pieces;
+            auto b0 = splits[p * (pieces + 1) + j];
+            auto b1 = splits[p * (pieces + 1) + j + 1];
+            auto out = dst + (std::ptrdiff_t)(a0 + (b0 - mid));
+            std::merge(std::make_move_iterator(src + (std::ptrdiff_t)a0),
+                       std::make_move_iterator(src + (std::ptrdiff_t)a1),
+                       std::make_move_iterator(src + (std::ptrdiff_t)b0),
+                       std::make_move_iterator(src + (std::ptrdiff_t)b1), out, comp);
+        }
+    });
+}
+
+} // namespace detail
+
+// f(i) for every i in [first, last)
+template <typename Pool, typename F>
+void ParallelFor(Pool &pool, size_t first, size_t last, F &&f, size_t grain = 0) {
+    detail::ParallelRun(pool, first, last, grain, detail::Participants(pool),
+                        [&f](size_t begin, size_t end, unsigned) {
+                            for (auto i = begin; i < end; ++i) {
+                                f(i);
+                            }
+                        });
+}
+
+// *(out + i) = f(*(first + i)), random access iterators
+template <typename Pool, typename InputIt, typename OutputIt, typename F>
+OutputIt ParallelTransform(Pool &pool, InputIt first, InputIt last, OutputIt out, F &&f, size_t grain = 0) {
+    auto n = (size_t)std::distance(first, last);
+    detail::ParallelRun(pool, 0, n, grain, detail::Participants(pool), [&](size_t begin, size_t end, unsigned) {
+        std::transform(first + (std::ptrdiff_t)begin, first + (std::ptrdiff_t)end, out + (std::ptrdiff_t)begin, f);
+    });
+    return out + (std::ptrdiff_t)n;
+}
+
+// op(init, all the elements), op must be associative and commutative
+template <typename Pool, typename It, typename T, typename Op = std::plus<>>
+T ParallelReduce(Pool &pool, It first, It last, T init, Op op = Op(), size_t grain = 0) {
+    struct alignas(128) Partial {
+        std::optional<T> value;
+    };
+    auto participants = detail::Participants(pool);
+    std::vector<Partial> partials(participants);
+    auto n = (size_t)std::distance(first, last);
+    detail::ParallelRun(pool, 0, n, grain, participants, [&](size_t begin, size_t end, unsigned slot) {
+        T acc = first[(std::ptrdiff_t)begin];
+        for (auto i = begin + 1; i < end; ++i) {
+            acc = op(std::move(acc), first[(std::ptrdiff_t)i]);
+        }
+        auto &partial = partials[slot].value;
+        partial = partial ? op(std::move(*partial), std::move(acc)) : std::move(acc);
+    });
+    for (auto &partial : partials) {
+        if (partial.value) {
+            init = op(std::move(init), std::move(*partial.value));
+        }
+    }
+    return init;
+}
+
+// not stable, grain is the smallest block sorted by one thread
+template <typename Pool, typename It, typename Compare = std::less<>>
+void ParallelSort(Pool &pool, It first, It last, Compare comp = Compare(), size_t grain = 0) {
+    using T = typename std::iterator_traits<It>::value_type;
+    auto n = (size_t)std::distance(first, last);
+    auto participants = detail::Participants(pool);
+    if (grain == 0) {
+        grain = 4096;
+    }
+    auto blocks = std::min<size_t>(2 * (size_t)participants, (n + grain - 1) / grain);
+    if (blocks <= 1) {
+        std::sort(first, last, comp);
+        return;
+    }
+    auto width = (n + blocks - 1) / blocks;
+    detail::ParallelRun(pool, 0, blocks, 1, participants, [&](size_t begin, size_t end, unsigned) {
+        for (auto b = begin; b < end; ++b) {
+            std::sort(first + (std::ptrdiff_t)(b * width), first + (std::ptrdiff_t)std::min(n, (b + 1) * width), comp);
+        }
+    });
+    std::vector<T> buffer(n);
+    bool in_buffer = false;
+    for (; width < n; width *= 2) {
+        if (in_buffer) {
+            detail::MergeRound(pool, buffer.begin(), first, n, width, participants, comp);
+        } else {
+            detail::MergeRound(pool, first, buffer.begin(), n, width, participants, comp);
+        }
+        in_buffer = !in_buffer;
+    }
+    if (in_buffer) {
+        detail::ParallelRun(pool, 0, n, 0, participants, [&](size_t begin, size_t end, unsigned) {
+            std::move(buffer.begin() + (std::ptrdiff_t)begin, buffer.begin() + (std::ptrdiff_t)end,
+                      first + (std::ptrdiff_t)begin);
+        });
+    }
+}
+
+} // namespace scorpion
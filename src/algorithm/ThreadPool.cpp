@@ -8,7 +8,17 @@
 namespace scorpion {
 
 using namespace std;
-using cbType = function<int()>;
+using cbType = ThreadPool::Callback;
+
+static void run(const cbType &callback) {
+    try {
+        callback();
+    } catch (std::exception &e) {
+        printf("[Warn] task throw exception %s\n", e.what());
+    } catch (...) {
+        printf("[Warn] task throw non-std::exception\n");
+    }
+}
 
 struct ThreadPool::Impl {
     static constexpr size_t kDefaultCapacity = 1024;
@@ -22,35 +32,32 @@ struct ThreadPool::Impl {
         , _queue(new BlockingQueue<cbType>(kDefaultCapacity)) {
         for (auto i = 0u; i < size; i++) {
             _workers.emplace_back([this]() {
-                while (_running.load(std::memory_order_relaxed)) {
+                while (true) {
                     cbType callback = nullptr;
-                    if (!_queue->TryPop(callback)) {
-                        continue;
-                    }
-                    try {
-                        callback();
-                    } catch (std::exception &e) {
-                        printf("[Warn] task throw exception %s\n", e.what());
-                    } catch (...) {
-                        printf("[Warn] task throw non-std::exception\n");
+                    // park until a task (or the empty stop marker) arrives
+                    _queue->Pop(callback);
+                    if (!callback) {
+                        break;
                     }
+                    run(callback);
                 }
             });
         }
     }
     ~Impl() {
         _running.store(false, std::memory_order_relaxed);
+        // one marker per worker, queued behind the pending tasks
+        for (size_t i = 0; i < _workers.size(); ++i) {
+            _queue->Push(cbType(nullptr));
+        }
         for (auto &t : _workers) {
             t.join();
         }
+        // tasks that raced with the stop
         cbType callback;
         while (_queue->TryPop(callback)) {
-            try {
-                callback();
-            } catch (std::exception &e) {
-                printf("[Warn] task throw exception %s\n", e.what());
-            } catch (...) {
-                printf("[Warn] task throw non-std::exception\n");
+            if (callback) {
+                run(callback);
             }
         }
     }
@@ -61,12 +68,45 @@ ThreadPool::ThreadPool(unsigned int size)
 
 ThreadPool::~ThreadPool() = default;
 
-bool ThreadPool::Push(function<int()> cb) {
-    if (!_impl->_running.load(std::memory_order_relaxed)) {
+unsigned ThreadPool::Size() const {
+    return (unsigned)_impl->_workers.size();
+}
+
+bool ThreadPool::Execute(Callback cb) {
+    return Push(std::move(cb));
+}
+
+unsigned ThreadPool::Concurrency() const {
+    return Size();
+}
+
+bool ThreadPool::Push(Callback cb) {
+    if (!_impl->_running.load(std::memory_order_relaxed) || !cb) {
         return false;
     }
     _impl->_queue->Push(std::move(cb));
     return true;
 }
 
-} // namespace scorpion
\ No newline at end of file
+bool ThreadPool::TryPush(Callback &&cb) {
+    if (!_impl->_running.load(std::memory_order_relaxed) || !cb) {
+        return false;
+    }
+    return _impl->_queue->TryPush(std::move(cb));
+}
+
+bool ThreadPool::RunPending() {
+    cbType callback;
+    if (!_impl->_queue->TryPop(callback)) {
+        return false;
+    }
+    if (!callback) {
+        // a stop marker belongs to a worker, put it back
+        _impl->_queue->Push(std::move(callback));
+        return false;
+    }
+    run(callback);
+    return true;
+}
+
+} // namespace scorpion
@@ -1,21 +1,76 @@
+/**
+ * A blocking thread pool: idle workers park on the queue and are woken by Push/Submit.
+ * It is also an Executor, see DefaultExecutor() for the one shared by the whole process.
+ *
+ */
+
 #pragma once
 
-#include <functional>
 #include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+
+#include "Executor.h"
+#include "Future.h"
+#include "InplaceFunction.h"
 
 namespace scorpion {
 
-class ThreadPool {
+class ThreadPool : public Executor {
+public:
+    using Callback = Executor::Callback;
+
 public:
     explicit ThreadPool(unsigned size);
-    ~ThreadPool();
+    ~ThreadPool() override;
 
 public:
-    bool Push(std::function<int()> cb);
+    // fire and forget, blocks while the queue is full
+    bool Push(Callback cb);
+
+    // never blocks, cb is moved from only if it was queued
+    bool TryPush(Callback &&cb);
+
+    // run one queued task on the calling thread (eg: a task waiting for its children), false if none
+    bool RunPending();
+
+    // number of workers
+    unsigned Size() const;
+
+    // Executor: same as Push
+    bool Execute(Callback cb) override;
+
+    unsigned Concurrency() const override;
+
+    // run f(args...) on the pool and get its result (or exception) through the future
+    template <typename F, typename... Args>
+    auto Submit(F &&f, Args &&... args)
+        -> Future<typename std::invoke_result<typename std::decay<F>::type, typename std::decay<Args>::type...>::type> {
+        using R =
+            typename std::invoke_result<typename std::decay<F>::type, typename std::decay<Args>::type...>::type;
+        auto state = std::make_shared<detail::FutureState<R>>();
+        auto task = [state, func = std::forward<F>(f),
+                     params = std::make_tuple(std::forward<Args>(args)...)]() mutable -> int {
+            detail::Fulfil(*state, [&]() -> R { return std::apply(std::move(func), std::move(params)); });
+            return 0;
+        };
+        bool ok = false;
+        if constexpr (Callback::Fits<decltype(task)>()) {
+            ok = Push(std::move(task));
+        } else {
+            // too large to be stored inline, pay one allocation
+            ok = Push([ptr = std::make_unique<decltype(task)>(std::move(task))]() { return (*ptr)(); });
+        }
+        if (!ok) {
+            state->SetException(std::make_exception_ptr(std::runtime_error("thread pool is stopped")));
+        }
+        return Future<R>(std::move(state));
+    }
 
 private:
     struct Impl;
     std::unique_ptr<Impl> _impl;
 };
 
-} // namespace scorpion
\ No newline at end of file
+} // namespace scorpion
@@ -1,15 +1,18 @@
 #include "TimeWheel.h"
 
+#include <atomic>
+#include <chrono>
 #include <list>
 #include <memory>
+#include <thread>
 #include <vector>
 
-#include "ThreadPool.h"
+#include "Executor.h"
 
 namespace scorpion {
 
 using namespace std;
-using cbType = function<int()>;
+using cbType = TimeWheelRaw::Callback;
 
 constexpr unsigned kTimeWheelSpan = 1;
 constexpr unsigned kTimeWheelSize = 10;
@@ -19,37 +22,70 @@ struct CEvent {
     unsigned _rotation;
     int _loop;
     cbType _callback;
+    atomic<bool> _busy; // async: a run of _callback is queued or in flight
 
     CEvent(unsigned interval, unsigned rotation, int loop, cbType cb)
         : _interval(interval)
         , _rotation(rotation)
         , _loop(loop)
-        , _callback(std::move(cb)) {}
+        , _callback(std::move(cb))
+        , _busy(false) {}
 
     CEvent(const CEvent &) = delete;
     CEvent &operator=(const CEvent &) = delete;
 };
 
-struct TimeWheelRaw::Impl {
-    static constexpr size_t kDefaultThreadNumber = 3;
+// shared with the callbacks running on the pool, so a repeating event never copies its callback
+using EventPtr = shared_ptr<CEvent>;
+
+// travels with an async run: once the executor is done with it, run (even throwing) or dropped, the event
+// may fire again and the wheel may go away
+struct Flight {
+    Flight(EventPtr e, atomic<unsigned> *counter)
+        : event(std::move(e))
+        , inflight(counter) {
+        inflight->fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Flight(Flight &&other) noexcept
+        : event(std::move(other.event))
+        , inflight(other.inflight) {}
+
+    Flight &operator=(Flight &&) = delete;
+
+    ~Flight() {
+        if (event != nullptr) {
+            event->_busy.store(false, std::memory_order_release);
+            // last access to the wheel
+            inflight->fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    EventPtr event;
+    atomic<unsigned> *inflight;
+};
 
-    const bool _async;
+struct TimeWheelRaw::Impl {
+    Executor *const _executor; // nullptr: callbacks run in Tick()
     const unsigned _span;
     const unsigned _size;
     unsigned _cursor;
-    vector<list<unique_ptr<CEvent>>> _slots;
-    unique_ptr<ThreadPool> _pool;
+    vector<list<EventPtr>> _slots;
+    atomic<unsigned> _inflight; // async runs queued or running
 
-    Impl(bool async, unsigned span, unsigned size)
-        : _async(async)
+    Impl(Executor *executor, unsigned span, unsigned size)
+        : _executor(executor)
         , _span(span)
         , _size(size)
         , _cursor(0)
-        , _pool(nullptr) {
+        , _inflight(0) {
         _slots.resize(size);
-        if (_async) {
-            _pool = std::make_unique<ThreadPool>(kDefaultThreadNumber);
-        }
+    }
+
+    unsigned Locate(unsigned interval, unsigned &rotation) const {
+        auto ticks = interval < _span ? 1u : interval / _span;
+        rotation = ticks / _size;
+        return (_cursor + ticks % _size) % _size;
     }
 };
 
@@ -58,23 +94,31 @@ struct TimeWheelRaw::Impl {
 namespace scorpion {
 
 TimeWheelRaw::TimeWheelRaw(bool async)
-    : _impl(new Impl(async, kTimeWheelSpan, kTimeWheelSize)) {}
+    : _impl(new Impl(async ? &DefaultExecutor() : nullptr, kTimeWheelSpan, kTimeWheelSize)) {}
 
-TimeWheelRaw::~TimeWheelRaw() = default;
+TimeWheelRaw::TimeWheelRaw(Executor &executor)
+    : _impl(new Impl(&executor, kTimeWheelSpan, kTimeWheelSize)) {}
+
+TimeWheelRaw::~TimeWheelRaw() {
+    // the callbacks (and what they capture from the owner) never outlive the wheel
+    while (_impl->_inflight.load(std::memory_order_acquire) > 0) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
 
 void TimeWheelRaw::Add(cbType cb, unsigned interval, int loop) {
-    auto ticks = interval < _impl->_span ? 1u : interval / _impl->_span;
-    auto rotation = ticks / _impl->_size;
-    auto index = (_impl->_cursor + ticks % _impl->_size) % _impl->_size;
-    auto event = make_unique<CEvent>(interval, rotation, loop, std::move(cb));
+    unsigned rotation = 0;
+    auto index = _impl->Locate(interval, rotation);
+    auto event = make_shared<CEvent>(interval, rotation, loop, std::move(cb));
     _impl->_slots[index].push_back(std::move(event));
 }
 
 void TimeWheelRaw::Tick() {
     auto &list = _impl->_slots[_impl->_cursor];
     for (auto iter = list.begin(); iter != list.end(); /*nothing*/) {
-        if ((*iter)->_rotation == 0) {
-            if (_impl->_async) {
+        auto &event = *iter;
+        if (event->_rotation == 0) {
+            if (_impl->_executor != nullptr) {
                 // bug with async(): temporary's dtor waits for (*iter)->_callback()
                 // async(launch::async, (*iter)->_callback);
 
@@ -82,25 +126,28 @@ void TimeWheelRaw::Tick() {
                 // thread t((*iter)->_callback);
                 // t.detach();
 
-                // how about a thread pool?
-                auto cb = (*iter)->_callback; // copy
-                _impl->_pool->Push(std::move(cb));
+                // how about a thread pool? a shared one (see Executor.h), a private pool per wheel
+                // oversubscribes the cores; share the event instead of copying the callback
+                // one run per event at a time: the callable (and its state) is shared by every fire, a
+                // repeating event still running when it is due again skips that fire
+                if (!event->_busy.exchange(true, std::memory_order_acq_rel)) {
+                    // a rejected run is destroyed at once, its Flight releases the event
+                    _impl->_executor->Execute([flight = Flight(event, &_impl->_inflight)]() {
+                        return flight.event->_callback();
+                    });
+                }
             } else {
-                (*iter)->_callback();
+                event->_callback();
             }
-            if ((*iter)->_loop < 0) {
-                auto interval = (*iter)->_interval;
-                this->Add(std::move((*iter)->_callback), interval, -1);
+            if (event->_loop < 0 || --event->_loop > 0) {
+                // move the node to its next slot, it may be this one (visited again below)
+                auto &next = _impl->_slots[_impl->Locate(event->_interval, event->_rotation)];
+                next.splice(next.end(), list, iter++);
             } else {
-                auto loop = --(*iter)->_loop;
-                if (loop > 0) {
-                    auto interval = (*iter)->_interval;
-                    this->Add(std::move((*iter)->_callback), interval, loop);
-                }
+                iter = list.erase(iter);
             }
-            iter = list.erase(iter);
         } else {
-            --(*iter)->_rotation;
+            --event->_rotation;
             ++iter;
         }
     }
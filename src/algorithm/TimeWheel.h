@@ -1,6 +1,10 @@
 /**
  * A raw implementation of timewheel and its wrapper.
  * Note that: better not use it when it comes to dealing with lots os task
+ * Async callbacks run on an Executor, DefaultExecutor() unless one is given. A repeating callback never
+ * runs twice at the same time: a fire due while the previous run is still queued or running is skipped.
+ * Destroying a wheel waits for its async callbacks still queued or running on the executor (so never
+ * destroy it from one of its callbacks); the executor itself is not stopped.
  *
  */
 
@@ -8,23 +12,31 @@
 
 #include <atomic>
 #include <chrono>
-#include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
 
+#include "Executor.h"
+#include "InplaceFunction.h"
+
 namespace scorpion {
 
 class TimeWheelRaw {
 public:
+    using Callback = InplaceFunction<int()>;
+
+public:
+    // async: callbacks run on DefaultExecutor() instead of in Tick()
     explicit TimeWheelRaw(bool async = false);
+    // callbacks run on executor, which must outlive the wheel
+    explicit TimeWheelRaw(Executor &executor);
     ~TimeWheelRaw();
 
     TimeWheelRaw(const TimeWheelRaw &) = delete;
     TimeWheelRaw &operator=(const TimeWheelRaw &) = delete;
 
 public:
-    void Add(std::function<int()> cb, unsigned int interval, int loop);
+    void Add(Callback cb, unsigned int interval, int loop);
     void Tick();
     void Dump() const;
 
@@ -39,13 +51,13 @@ public:
     explicit TimeWheel(bool async = false)
         : _twr(new TimeWheelRaw(async))
         , _running(true)
-        , _thread([this]() {
-            while (_running.load(std::memory_order_acquire)) {
-                std::this_thread::sleep_for(Resolution(1));
-                std::lock_guard<std::mutex> lock(_mutex);
-                _twr->Tick();
-            }
-        }) {}
+        , _thread([this]() { run(); }) {}
+
+    explicit TimeWheel(Executor &executor)
+        : _twr(new TimeWheelRaw(executor))
+        , _running(true)
+        , _thread([this]() { run(); }) {}
+
     ~TimeWheel() {
         _running.store(false, std::memory_order_release);
         if (_thread.joinable()) {
@@ -57,11 +69,20 @@ public:
     TimeWheel &operator=(const TimeWheel &) = delete;
 
 public:
-    void Add(std::function<int()> cb, unsigned int interval, int loop) {
+    void Add(TimeWheelRaw::Callback cb, unsigned int interval, int loop) {
         std::lock_guard<std::mutex> lock(_mutex);
         _twr->Add(std::move(cb), interval, loop);
     }
 
+private:
+    void run() {
+        while (_running.load(std::memory_order_acquire)) {
+            std::this_thread::sleep_for(Resolution(1));
+            std::lock_guard<std::mutex> lock(_mutex);
+            _twr->Tick();
+        }
+    }
+
 private:
     std::unique_ptr<TimeWheelRaw> _twr;
     std::atomic<bool> _running;
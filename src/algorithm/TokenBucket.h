@@ -1,5 +1,6 @@
 /**
  * A implementation of token-bucket algorithm.
+ * size: the most tokens the bucket holds, rate: tokens added per second. Not thread safe.
  *
  */
 
@@ -22,9 +23,18 @@ public:
 public:
     bool grant() {
         auto now = std::chrono::steady_clock::now();
-        auto in = (now - _ts).count() * _rate;
-        _token = std::min(_size, _token + in);
-        _ts = now;
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _ts).count();
+        if (_rate <= 0) {
+            _ts = now;
+        } else if (elapsed >= (_size - _token) * kNanosPerSecond / _rate) {
+            _token = _size;
+            _ts = now;
+        } else {
+            auto in = elapsed * _rate / kNanosPerSecond;
+            // keep the remainder for the next call
+            _token += in;
+            _ts += std::chrono::nanoseconds(in * kNanosPerSecond / _rate);
+        }
         if (_token > 0) {
             --_token;
             return true; // passed
@@ -34,6 +44,8 @@ public:
     }
 
 private:
+    static constexpr int64_t kNanosPerSecond = 1000000000;
+
     int64_t _size;
     int64_t _rate;
     std::chrono::time_point<std::chrono::steady_clock> _ts;
@@ -0,0 +1,61 @@
+/**
+ * Cooperative cancellation: a CancelSource owns the flag, any number of CancelTokens observe it.
+ *
+ * Key Features:
+ * 0. A default constructed CancelToken is never cancelled and costs nothing to check.
+ * 1. Cancel() is one atomic store, observers see it with acquire ordering; it cannot be undone.
+ * 2. Tokens keep the flag alive, the source may go away before the work it guards.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+namespace scorpion {
+
+class CancelToken {
+public:
+    CancelToken() = default;
+
+    explicit CancelToken(std::shared_ptr<const std::atomic<bool>> state)
+        : _state(std::move(state)) {}
+
+public:
+    bool Cancelled() const {
+        return _state != nullptr && _state->load(std::memory_order_acquire);
+    }
+
+    // false for a token that can never be cancelled
+    bool Valid() const {
+        return _state != nullptr;
+    }
+
+private:
+    std::shared_ptr<const std::atomic<bool>> _state;
+};
+
+class CancelSource {
+public:
+    CancelSource()
+        : _state(std::make_shared<std::atomic<bool>>(false)) {}
+
+public:
+    CancelToken Token() const {
+        return CancelToken(_state);
+    }
+
+    void Cancel() {
+        _state->store(true, std::memory_order_release);
+    }
+
+    bool Cancelled() const {
+        return _state->load(std::memory_order_acquire);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> _state;
+};
+
+} // namespace scorpion
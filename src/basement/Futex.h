@@ -0,0 +1,49 @@
+/**
+ * Thin wrappers of the linux futex syscall on a std::atomic<uint32_t>.
+ * Waits may return spuriously, always re-check the condition in a loop.
+ *
+ */
+
+#pragma once
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+
+namespace scorpion {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+
+// block while *addr == expected
+inline void FutexWait(std::atomic<uint32_t> *addr, uint32_t expected) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+// block while *addr == expected for at most timeout, return false if timed out
+inline bool FutexWaitFor(std::atomic<uint32_t> *addr, uint32_t expected, std::chrono::nanoseconds timeout) {
+    if (timeout.count() <= 0) {
+        return false;
+    }
+    timespec ts{};
+    ts.tv_sec = (time_t)(timeout.count() / 1000000000);
+    ts.tv_nsec = (long)(timeout.count() % 1000000000);
+    auto ret = syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+    return !(ret == -1 && errno == ETIMEDOUT);
+}
+
+inline void FutexWake(std::atomic<uint32_t> *addr, int count = 1) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+inline void FutexWakeAll(std::atomic<uint32_t> *addr) {
+    FutexWake(addr, INT_MAX);
+}
+
+} // namespace scorpion
@@ -0,0 +1,130 @@
+/**
+ * A move-only std::function replacement which stores the callable in an inline buffer.
+ *
+ * Key Features:
+ * 0. Never allocates: a callable larger than Capacity (or over aligned) fails to compile,
+ *    use Fits<F>() to choose a fallback (eg: wrap it in a unique_ptr) in generic code.
+ * 1. Move-only, so it also accepts move-only callables (eg: lambdas capturing a unique_ptr).
+ * 2. The default capacity makes the object one cache line.
+ * 3. Calling an empty InplaceFunction throws std::bad_function_call.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace scorpion {
+
+// together with the vtable pointer (and padding) an InplaceFunction takes 64 bytes
+constexpr size_t kInplaceFunctionCapacity = 48;
+
+template <typename Signature, size_t Capacity = kInplaceFunctionCapacity>
+class InplaceFunction;
+
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> {
+public:
+    InplaceFunction() noexcept
+        : _vtable(nullptr) {}
+
+    InplaceFunction(std::nullptr_t) noexcept
+        : _vtable(nullptr) {}
+
+    template <typename F, typename D = typename std::decay<F>::type,
+              typename = typename std::enable_if<!std::is_same<D, InplaceFunction>::value &&
+                                                 std::is_invocable_r<R, D &, Args...>::value>::type>
+    InplaceFunction(F &&f) noexcept(std::is_nothrow_constructible<D, F &&>::value)
+        : _vtable(nullptr) {
+        static_assert(Fits<D>(), "callable is too large or over aligned for this InplaceFunction, raise Capacity");
+        static_assert(std::is_nothrow_move_constructible<D>::value, "callable must be nothrow move constructible");
+        new (&_storage) D(std::forward<F>(f));
+        _vtable = vtable<D>();
+    }
+
+    InplaceFunction(InplaceFunction &&other) noexcept
+        : _vtable(other._vtable) {
+        if (_vtable != nullptr) {
+            _vtable->move(&_storage, &other._storage);
+            other.reset();
+        }
+    }
+
+    InplaceFunction &operator=(InplaceFunction &&other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other._vtable != nullptr) {
+                _vtable = other._vtable;
+                _vtable->move(&_storage, &other._storage);
+                other.reset();
+            }
+        }
+        return *this;
+    }
+
+    InplaceFunction &operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    ~InplaceFunction() {
+        reset();
+    }
+
+    InplaceFunction(const InplaceFunction &) = delete;
+    InplaceFunction &operator=(const InplaceFunction &) = delete;
+
+public:
+    // same as std::function, the callable itself may be mutable
+    R operator()(Args... args) const {
+        if (_vtable == nullptr) {
+            throw std::bad_function_call();
+        }
+        return _vtable->invoke(const_cast<Storage *>(&_storage), std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept {
+        return _vtable != nullptr;
+    }
+
+    template <typename F>
+    static constexpr bool Fits() {
+        using D = typename std::decay<F>::type;
+        return sizeof(D) <= Capacity && alignof(D) <= alignof(Storage);
+    }
+
+private:
+    using Storage = typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type;
+
+    struct VTable {
+        R (*invoke)(void *, Args &&...);
+        void (*move)(void *, void *);
+        void (*destroy)(void *);
+    };
+
+    template <typename D>
+    static const VTable *vtable() {
+        static const VTable table{
+            [](void *f, Args &&... args) -> R { return (*static_cast<D *>(f))(std::forward<Args>(args)...); },
+            [](void *dst, void *src) { new (dst) D(std::move(*static_cast<D *>(src))); },
+            [](void *f) { static_cast<D *>(f)->~D(); }};
+        return &table;
+    }
+
+    void reset() noexcept {
+        if (_vtable != nullptr) {
+            _vtable->destroy(&_storage);
+            _vtable = nullptr;
+        }
+    }
+
+private:
+    Storage _storage;
+    const VTable *_vtable;
+};
+
+} // namespace scorpion
@@ -0,0 +1,101 @@
+/**
+ * Idle protocol for a consumer thread: spin, then yield, then park on a futex.
+ *
+ * Key Features:
+ * 0. Idle() is called after each empty poll: the first kSpin calls spin with a cpu pause, the next
+ *    kYield calls yield, after that the thread parks until Unpark() or timeout (0: no timeout).
+ * 1. The consumer raises a sleeping flag and re-checks ready() before it blocks, the producer
+ *    publishes its item and then checks the flag (both behind a seq_cst fence), so a wake is never
+ *    lost and Unpark() costs a syscall only if the consumer is really parked.
+ * 2. Parks() counts how often the thread actually went to sleep.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "Futex.h"
+
+namespace scorpion {
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+class Parker {
+public:
+    static constexpr unsigned kSpin = 64;
+    static constexpr unsigned kYield = 16;
+
+public:
+    Parker()
+        : _epoch(0)
+        , _sleeping(0)
+        , _parks(0) {}
+
+    Parker(const Parker &) = delete;
+    Parker &operator=(const Parker &) = delete;
+
+public:
+    // consumer, idle is the number of empty polls in a row (reset it after a hit)
+    template <typename Ready>
+    void Idle(unsigned &idle, const Ready &ready, unsigned timeout_ms) {
+        if (idle < kSpin) {
+            ++idle;
+            CpuRelax();
+            return;
+        }
+        if (idle < kSpin + kYield) {
+            ++idle;
+            std::this_thread::yield();
+            return;
+        }
+        auto epoch = _epoch.load(std::memory_order_acquire);
+        _sleeping.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready()) {
+            if (timeout_ms > 0) {
+                FutexWaitFor(&_epoch, epoch, std::chrono::milliseconds(timeout_ms));
+            } else {
+                FutexWait(&_epoch, epoch);
+            }
+            _parks.fetch_add(1, std::memory_order_relaxed);
+        }
+        _sleeping.store(0, std::memory_order_relaxed);
+        idle = 0;
+    }
+
+    // producer, after the item is visible to ready(), return true if a parked consumer was woken
+    bool Unpark() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_sleeping.load(std::memory_order_relaxed) == 0) {
+            return false;
+        }
+        _epoch.fetch_add(1, std::memory_order_release);
+        FutexWake(&_epoch);
+        return true;
+    }
+
+    bool Sleeping() const {
+        return _sleeping.load(std::memory_order_relaxed) != 0;
+    }
+
+    uint64_t Parks() const {
+        return _parks.load(std::memory_order_relaxed);
+    }
+
+private:
+    alignas(64) std::atomic<uint32_t> _epoch;
+    std::atomic<uint32_t> _sleeping;
+    std::atomic<uint64_t> _parks;
+};
+
+} // namespace scorpion
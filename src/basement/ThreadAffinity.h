@@ -0,0 +1,208 @@
+/**
+ * Helpers to place and label the calling thread.
+ *
+ * Key Features:
+ * 0. AllowedCpus()/PinThread()/PinCpu()/SetThreadName() act on the calling thread.
+ * 1. CpuTopology reads sysfs for the allowed cpus only: SMT siblings (core), last level cache and NUMA
+ *    node. A file it cannot read (containers, non-linux sysfs) makes each cpu its own core on one cache
+ *    and one node, so callers never have to care whether the topology is real.
+ * 2. PlacementOrder() lists cpus for a pool: one per physical core first, grouped by cache and node so
+ *    that neighbouring workers share the most, SMT siblings last.
+ * 3. Distance() ranks two cpus by what they share, eg: to order steal victims.
+ *
+ */
+
+#pragma once
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace scorpion {
+
+// the cpus the calling thread is allowed to run on (honours cpusets, eg: containers)
+inline std::vector<int> AllowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return cpus;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// pin the calling thread to the slot-th allowed cpu (wraps around)
+inline bool PinThread(unsigned slot) {
+    auto cpus = AllowedCpus();
+    if (cpus.empty()) {
+        return false;
+    }
+    cpu_set_t target;
+    CPU_ZERO(&target);
+    CPU_SET(cpus[slot % cpus.size()], &target);
+    return pthread_setaffinity_np(pthread_self(), sizeof(target), &target) == 0;
+}
+
+// pin the calling thread to one cpu
+inline bool PinCpu(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t target;
+    CPU_ZERO(&target);
+    CPU_SET(cpu, &target);
+    return pthread_setaffinity_np(pthread_self(), sizeof(target), &target) == 0;
+}
+
+// name the calling thread as shown by top/gdb, truncated to 15 characters
+inline bool SetThreadName(const std::string &name) {
+    return pthread_setname_np(pthread_self(), name.substr(0, 15).c_str()) == 0;
+}
+
+struct CpuInfo {
+    int cpu;
+    int package; // physical socket
+    int core;    // core id within the package, SMT siblings share it
+    int llc;     // lowest cpu sharing the last level cache
+    int node;    // NUMA node
+};
+
+class CpuTopology {
+public:
+    // the allowed cpus of the process, read once
+    static const CpuTopology &Get() {
+        static const CpuTopology topology(AllowedCpus());
+        return topology;
+    }
+
+    explicit CpuTopology(const std::vector<int> &cpus, const std::string &root = "/sys/devices/system/cpu") {
+        _cpus.reserve(cpus.size());
+        for (auto cpu : cpus) {
+            auto dir = root + "/cpu" + std::to_string(cpu);
+            CpuInfo info{cpu, 0, cpu, 0, 0};
+            readInt(dir + "/topology/physical_package_id", info.package);
+            readInt(dir + "/topology/core_id", info.core);
+            info.llc = lastLevelCache(dir, cpu);
+            info.node = numaNode(dir);
+            _cpus.push_back(info);
+        }
+    }
+
+public:
+    const std::vector<CpuInfo> &Cpus() const {
+        return _cpus;
+    }
+
+    // where worker i of a pool goes: PlacementOrder()[i % size]
+    std::vector<int> PlacementOrder() const {
+        auto sorted = _cpus;
+        std::sort(sorted.begin(), sorted.end(), [](const CpuInfo &lhs, const CpuInfo &rhs) {
+            return std::tie(lhs.node, lhs.llc, lhs.package, lhs.core, lhs.cpu) <
+                   std::tie(rhs.node, rhs.llc, rhs.package, rhs.core, rhs.cpu);
+        });
+        std::vector<int> order;
+        std::vector<int> siblings;
+        for (size_t idx = 0; idx < sorted.size(); ++idx) {
+            bool first = idx == 0 || sorted[idx].package != sorted[idx - 1].package ||
+                         sorted[idx].core != sorted[idx - 1].core;
+            (first ? order : siblings).push_back(sorted[idx].cpu);
+        }
+        order.insert(order.end(), siblings.begin(), siblings.end());
+        return order;
+    }
+
+    // 0: same cpu, 1: SMT siblings, 2: same last level cache, 3: same node, 4: remote (or unknown cpu)
+    unsigned Distance(int lhs, int rhs) const {
+        auto a = find(lhs);
+        auto b = find(rhs);
+        if (a == nullptr || b == nullptr) {
+            return 4;
+        }
+        if (a->cpu == b->cpu) {
+            return 0;
+        }
+        if (a->package == b->package && a->core == b->core) {
+            return 1;
+        }
+        if (a->llc == b->llc) {
+            return 2;
+        }
+        return a->node == b->node ? 3 : 4;
+    }
+
+private:
+    const CpuInfo *find(int cpu) const {
+        for (auto &info : _cpus) {
+            if (info.cpu == cpu) {
+                return &info;
+            }
+        }
+        return nullptr;
+    }
+
+    // leaves value untouched if the file cannot be read
+    static bool readInt(const std::string &path, int &value) {
+        auto file = fopen(path.c_str(), "r");
+        if (file == nullptr) {
+            return false;
+        }
+        int parsed = 0;
+        bool ok = fscanf(file, "%d", &parsed) == 1;
+        fclose(file);
+        if (ok) {
+            value = parsed;
+        }
+        return ok;
+    }
+
+    // the cache with the highest level, named after the first cpu of its (sorted) shared_cpu_list
+    static int lastLevelCache(const std::string &dir, int cpu) {
+        int best_level = -1;
+        int llc = 0;
+        for (int index = 0;; ++index) {
+            auto cache = dir + "/cache/index" + std::to_string(index);
+            int level = 0;
+            if (!readInt(cache + "/level", level)) {
+                break;
+            }
+            int first = cpu;
+            if (level > best_level && readInt(cache + "/shared_cpu_list", first)) {
+                best_level = level;
+                llc = first;
+            }
+        }
+        return llc;
+    }
+
+    static int numaNode(const std::string &dir) {
+        int node = 0;
+        auto entries = opendir(dir.c_str());
+        if (entries == nullptr) {
+            return node;
+        }
+        while (auto entry = readdir(entries)) {
+            if (strncmp(entry->d_name, "node", 4) == 0 && sscanf(entry->d_name + 4, "%d", &node) == 1) {
+                break;
+            }
+        }
+        closedir(entries);
+        return node;
+    }
+
+private:
+    std::vector<CpuInfo> _cpus;
+};
+
+} // namespace scorpion
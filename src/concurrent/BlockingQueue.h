@@ -4,6 +4,8 @@
 #include <condition_variable>
 #include <mutex>
 
+#include "SPSCQueue.h"
+
 namespace scorpion {
 
 template <typename T>
@@ -13,13 +15,20 @@ public:
         : _capacity(capacity)
         , _head(new Node)
         , _tail(_head)
-        , _size(0) {}
+        , _size(0)
+        , _pop_waiters(0)
+        , _push_waiters(0)
+        , _spare(capacity + 2) {}
 
     ~BlockingQueue() {
         T v;
         while (TryPop(v)) {
         }
         delete _head;
+        Node *node = nullptr;
+        while (_spare.TryPop(node)) {
+            delete node;
+        }
     }
 
     BlockingQueue(const BlockingQueue &other) = delete;
@@ -41,28 +50,54 @@ public:
         static_assert(std::is_nothrow_constructible<T, Args &&...>::value,
                       "T must be nothrow constructible with Args&&...");
         std::unique_lock<std::mutex> lock(_tail_mtx);
-        _not_full.wait(lock, [this]() { return _size.load(std::memory_order_relaxed) < _capacity; });
+        if (_size.load() >= _capacity) {
+            _push_waiters.fetch_add(1);
+            _not_full.wait(lock, [this]() { return _size.load() < _capacity; });
+            _push_waiters.fetch_sub(1);
+        }
         _tail->value = T(std::forward<Args>(args)...);
-        Node *new_tail = new Node;
+        Node *new_tail = acquire();
         _tail->next = new_tail;
         _tail = new_tail;
         lock.unlock();
 
-        _size.fetch_add(1, std::memory_order_relaxed);
-        _not_empty.notify_one();
+        _size.fetch_add(1);
+        notify(_pop_waiters, _head_mtx, _not_empty);
+    }
+
+    // never waits, v is moved from only if it was queued
+    template <typename P, typename = typename std::enable_if<std::is_nothrow_constructible<T, P &&>::value>::type>
+    bool TryPush(P &&v) noexcept {
+        std::unique_lock<std::mutex> lock(_tail_mtx);
+        if (_size.load() >= _capacity) {
+            return false;
+        }
+        _tail->value = T(std::forward<P>(v));
+        Node *new_tail = acquire();
+        _tail->next = new_tail;
+        _tail = new_tail;
+        lock.unlock();
+
+        _size.fetch_add(1);
+        notify(_pop_waiters, _head_mtx, _not_empty);
+        return true;
     }
 
     void Pop(T &v) noexcept {
         std::unique_lock<std::mutex> lock(_head_mtx);
-        _not_empty.wait(lock, [this]() { return _head != get_tail(); });
+        if (_head == get_tail()) {
+            _pop_waiters.fetch_add(1);
+            _not_empty.wait(lock, [this]() { return _head != get_tail(); });
+            _pop_waiters.fetch_sub(1);
+        }
         Node *old_head = _head;
         v = std::move(old_head->value);
         _head = old_head->next;
+        release(old_head);
         lock.unlock();
 
         _size.fetch_sub(1);
-        _not_full.notify_one();
-        delete old_head;
+        notify(_push_waiters, _tail_mtx, _not_full);
     }
 
     bool TryPop(T &v) noexcept {
@@ -74,11 +109,11 @@ public:
         Node *old_head = _head;
         v = std::move(_head->value);
         _head = old_head->next;
+        release(old_head);
         lock.unlock();
 
         _size.fetch_sub(1);
-        _not_full.notify_one();
-        delete old_head;
+        notify(_push_waiters, _tail_mtx, _not_full);
         return true;
     }
 
@@ -111,15 +146,46 @@ private:
         return _tail;
     }
 
+    // Consumed nodes go back to the producers through _spare, the head mutex serializes the
+    // consumers and the tail mutex the producers, so it has a single producer and a single consumer.
+    Node *acquire() {
+        Node *node = nullptr;
+        if (_spare.TryPop(node)) {
+            node->next = nullptr;
+            return node;
+        }
+        return new Node;
+    }
+
+    void release(Node *node) {
+        if (!_spare.TryPush(node)) {
+            delete node;
+        }
+    }
+
+    // A waiter registers itself before checking its predicate under mtx, so once the state
+    // changed, either it sees the change or we see it; passing through mtx makes sure it
+    // is already waiting and can not miss the notification.
+    static void notify(const std::atomic<size_t> &waiters, std::mutex &mtx, std::condition_variable &cond) {
+        if (waiters.load() == 0) {
+            return;
+        }
+        { std::lock_guard<std::mutex> lock(mtx); }
+        cond.notify_one();
+    }
+
 private:
     const size_t _capacity;
     Node *_head;
     Node *_tail;
     std::atomic<size_t> _size;
+    std::atomic<size_t> _pop_waiters;
+    std::atomic<size_t> _push_waiters;
     mutable std::mutex _head_mtx;
     mutable std::mutex _tail_mtx;
     std::condition_variable _not_empty;
     std::condition_variable _not_full;
+    SPSCQueue<Node *> _spare;
 };
 
 } // namespace scorpion
@@ -1,84 +1,169 @@
 /**
  * A implementation of concurrent queue.
  *
+ * Elements live in a growable ring buffer (T must be default constructible), the
+ * consumers are only notified when someone is waiting, and DrainAll() swaps the
+ * whole ring out under one lock acquisition.
+ *
  */
 
 #pragma once
 
+#include <algorithm>
 #include <condition_variable>
-#include <memory>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <vector>
 
 namespace scorpion {
 
 template <typename T>
 class ConcurrentQueue {
 public:
-    ConcurrentQueue() = default;
+    explicit ConcurrentQueue(size_t capacity = kDefaultCapacity)
+        : _ring(capacity < 1 ? 1 : capacity)
+        , _head(0)
+        , _size(0)
+        , _waiters(0) {}
     ~ConcurrentQueue() = default;
 
     ConcurrentQueue(const ConcurrentQueue &other) {
         std::lock_guard<std::mutex> lock(other._mtx);
-        _data = other._data;
+        _ring = other._ring;
+        _head = other._head;
+        _size = other._size;
+        _waiters = 0;
     };
     ConcurrentQueue &operator=(const ConcurrentQueue &) = delete;
 
 public:
     void Push(T val) {
-        std::lock_guard<std::mutex> lock(_mtx);
-        _data.push(std::move(val));
-        _cond.notify_one();
+        std::unique_lock<std::mutex> lock(_mtx);
+        if (_size == _ring.size()) {
+            grow();
+        }
+        auto tail = _head + _size;
+        if (tail >= _ring.size()) {
+            tail -= _ring.size();
+        }
+        _ring[tail] = std::move(val);
+        ++_size;
+        bool wake = _waiters > 0;
+        lock.unlock();
+        if (wake) {
+            _cond.notify_one();
+        }
     }
 
-    std::shared_ptr<T> Pop() {
-        std::unique_lock<std::mutex> lock(_mtx);
-        _cond.wait(lock, [this]() -> bool { return !_data.empty(); });
-        std::shared_ptr<T> res(std::make_shared<T>(std::move(_data.front())));
-        _data.pop();
-        return res;
+    T Pop() {
+        T val;
+        Pop(val);
+        return val;
     }
 
     void Pop(T &val) {
         std::unique_lock<std::mutex> lock(_mtx);
-        _cond.wait(lock, [this]() -> bool { return !_data.empty(); });
-        val = std::move(_data.front());
-        _data.pop();
+        if (_size == 0) {
+            ++_waiters;
+            _cond.wait(lock, [this]() -> bool { return _size != 0; });
+            --_waiters;
+        }
+        take(val);
     }
 
-    std::shared_ptr<T> TryPop() {
+    std::optional<T> TryPop() {
         std::lock_guard<std::mutex> lock(_mtx);
-        if (_data.empty()) {
-            return std::shared_ptr<T>();
+        if (_size == 0) {
+            return std::nullopt;
         }
-        std::shared_ptr<T> res(std::make_shared<T>(std::move(_data.front())));
-        _data.pop();
+        std::optional<T> res(std::move(_ring[_head]));
+        advance();
         return res;
     }
 
     bool TryPop(T &val) {
         std::lock_guard<std::mutex> lock(_mtx);
-        if (_data.empty()) {
+        if (_size == 0) {
             return false;
         }
-
-        val = std::move(_data.front());
-        _data.pop();
+        take(val);
         return true;
     }
 
+    // Replace the content of out with all the queued elements in order and return the count.
+    // The ring is swapped with out's storage, so draining into the same vector again and again
+    // does not allocate once both buffers are large enough.
+    size_t DrainAll(std::vector<T> &out) {
+        out.clear();
+        size_t head = 0;
+        size_t size = 0;
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            if (_size == 0) {
+                return 0;
+            }
+            _ring.swap(out);
+            head = _head;
+            size = _size;
+            _head = 0;
+            _size = 0;
+        }
+        std::rotate(out.begin(), out.begin() + (std::ptrdiff_t)head, out.end());
+        out.resize(size);
+        return size;
+    }
+
     bool Empty() const {
         std::lock_guard<std::mutex> lock(_mtx);
-        return _data.empty();
+        return _size == 0;
     }
 
     size_t Size() const {
         std::lock_guard<std::mutex> lock(_mtx);
-        return _data.size();
+        return _size;
+    }
+
+private:
+    static constexpr size_t kDefaultCapacity = 64;
+
+    void take(T &val) {
+        val = std::move(_ring[_head]);
+        advance();
+    }
+
+    void advance() {
+        if (++_head == _ring.size()) {
+            _head = 0;
+        }
+        if (--_size == 0) {
+            _head = 0;
+        }
+    }
+
+    void grow() {
+        auto capacity = std::max(kDefaultCapacity, _ring.size() * 2);
+        if (_head == 0) {
+            // contiguous, also reuses the storage a DrainAll() left behind
+            _ring.resize(capacity);
+            return;
+        }
+        std::vector<T> ring(capacity);
+        for (size_t i = 0; i < _size; ++i) {
+            auto idx = _head + i;
+            if (idx >= _ring.size()) {
+                idx -= _ring.size();
+            }
+            ring[i] = std::move(_ring[idx]);
+        }
+        _ring.swap(ring);
+        _head = 0;
     }
 
 private:
-    std::queue<T> _data;
+    std::vector<T> _ring;
+    size_t _head;
+    size_t _size;
+    size_t _waiters;
     mutable std::mutex _mtx;
     std::condition_variable _cond;
 };
@@ -0,0 +1,118 @@
+/**
+ * A lock-free queue paired with an eventfd, so the consumer side can wait on it
+ * with epoll/poll together with sockets.
+ *
+ * Key Features:
+ * 0. Queue is any of SPSCQueue/MPSCQueue/MPMCQueue (anything with TryPush/TryPop).
+ * 1. The eventfd is only written when the queue turns from "signaled = false" to
+ *    "signaled = true", producers racing on a non-empty queue do no syscall.
+ * 2. Consumer calls Consume() (or Acknowledge() then TryPop() until empty) every time
+ *    Fd() becomes readable; leftovers beyond the budget re-signal the fd.
+ *
+ */
+
+#pragma once
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+#include "MPSCQueue.h"
+
+namespace scorpion {
+
+template <typename T, typename Queue = MPSCQueue<T>>
+class EventQueue {
+public:
+    explicit EventQueue(size_t capacity)
+        : _queue(capacity)
+        , _fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+        , _signaled(false) {
+        if (_fd == -1) {
+            throw std::system_error(errno, std::system_category(), "eventfd");
+        }
+    }
+
+    ~EventQueue() {
+        close(_fd);
+    }
+
+    EventQueue(const EventQueue &) = delete;
+    EventQueue &operator=(const EventQueue &) = delete;
+
+public:
+    // readable while there may be elements not yet consumed
+    int Fd() const {
+        return _fd;
+    }
+
+    template <typename P>
+    bool TryPush(P &&v) {
+        if (!_queue.TryPush(std::forward<P>(v))) {
+            return false;
+        }
+        Signal();
+        return true;
+    }
+
+    template <typename... Args>
+    bool TryEmplace(Args &&... args) {
+        if (!_queue.TryEmplace(std::forward<Args>(args)...)) {
+            return false;
+        }
+        Signal();
+        return true;
+    }
+
+    bool TryPop(T &v) {
+        return _queue.TryPop(v);
+    }
+
+    // clear the readiness of Fd(), must be followed by popping until the queue is empty
+    void Acknowledge() {
+        uint64_t count = 0;
+        while (read(_fd, &count, sizeof(count)) == -1 && errno == EINTR) {
+        }
+        _signaled.store(false, std::memory_order_relaxed);
+        // pairs with the fence in Signal(): either we see the element or the producer sees false
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    // acknowledge and pop at most limit elements into f, re-signal if more may be left
+    template <typename F>
+    size_t Consume(F &&f, size_t limit = SIZE_MAX) {
+        Acknowledge();
+        size_t count = 0;
+        T v;
+        while (count < limit && _queue.TryPop(v)) {
+            f(std::move(v));
+            ++count;
+        }
+        if (count == limit) {
+            Signal();
+        }
+        return count;
+    }
+
+    // mark the queue readable, coalesced with the pending signal if any
+    void Signal() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_signaled.load(std::memory_order_relaxed) || _signaled.exchange(true)) {
+            return;
+        }
+        uint64_t one = 1;
+        while (write(_fd, &one, sizeof(one)) == -1 && errno == EINTR) {
+        }
+    }
+
+private:
+    Queue _queue;
+    const int _fd;
+    std::atomic<bool> _signaled;
+};
+
+} // namespace scorpion
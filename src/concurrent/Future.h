@@ -0,0 +1,257 @@
+/**
+ * A lightweight promise/future pair.
+ *
+ * Key Features:
+ * 0. One shared state per value, no mutex or condition variable: the state is a single
+ *    atomic word, waiters park on it with a futex and are only woken if there are any.
+ * 1. Then(f) registers a continuation which runs on the thread completing the value
+ *    (or inline if it is ready already) and returns the future of f's result.
+ * 2. Exceptions are carried to Get() and through Then() chains.
+ * 3. Get() and Then() consume the future.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+
+#include "Futex.h"
+
+namespace scorpion {
+
+template <typename T>
+class Future;
+
+namespace detail {
+
+template <typename T>
+class FutureState {
+public:
+    using Storage = typename std::conditional<std::is_void<T>::value, char, T>::type;
+
+public:
+    FutureState()
+        : _state(0) {}
+
+    FutureState(const FutureState &) = delete;
+    FutureState &operator=(const FutureState &) = delete;
+
+public:
+    template <typename... Args>
+    void SetValue(Args &&... args) {
+        _value.emplace(std::forward<Args>(args)...);
+        publish();
+    }
+
+    void SetException(std::exception_ptr error) {
+        _error = std::move(error);
+        publish();
+    }
+
+    bool Ready() const {
+        return (_state.load(std::memory_order_acquire) & kReady) != 0;
+    }
+
+    void Wait() {
+        auto state = _state.load(std::memory_order_acquire);
+        while ((state & kReady) == 0) {
+            if ((state & kWaiting) == 0 && !_state.compare_exchange_weak(state, state | kWaiting)) {
+                continue;
+            }
+            FutexWait(&_state, state | kWaiting);
+            state = _state.load(std::memory_order_acquire);
+        }
+    }
+
+    bool WaitFor(std::chrono::nanoseconds timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        auto state = _state.load(std::memory_order_acquire);
+        while ((state & kReady) == 0) {
+            if ((state & kWaiting) == 0 && !_state.compare_exchange_weak(state, state | kWaiting)) {
+                continue;
+            }
+            auto left = deadline - std::chrono::steady_clock::now();
+            if (left <= std::chrono::nanoseconds::zero()) {
+                return false;
+            }
+            FutexWaitFor(&_state, state | kWaiting, left);
+            state = _state.load(std::memory_order_acquire);
+        }
+        return true;
+    }
+
+    // run cb once the state is ready, inline if it is ready already
+    void OnReady(std::function<void()> cb) {
+        _continuation = std::move(cb);
+        auto prev = _state.fetch_or(kContinuation, std::memory_order_acq_rel);
+        if (prev & kReady) {
+            runContinuation();
+        }
+    }
+
+    // call after Wait()
+    Storage &Value() {
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+        return *_value;
+    }
+
+    const std::exception_ptr &Error() const {
+        return _error;
+    }
+
+private:
+    enum : uint32_t { kReady = 1u, kContinuation = 2u, kWaiting = 4u };
+
+    void publish() {
+        auto prev = _state.fetch_or(kReady, std::memory_order_acq_rel);
+        if (prev & kWaiting) {
+            FutexWakeAll(&_state);
+        }
+        if (prev & kContinuation) {
+            runContinuation();
+        }
+    }
+
+    void runContinuation() {
+        auto cb = std::move(_continuation);
+        _continuation = nullptr;
+        cb();
+    }
+
+private:
+    std::atomic<uint32_t> _state;
+    std::optional<Storage> _value;
+    std::exception_ptr _error;
+    std::function<void()> _continuation;
+};
+
+// run f and store its result (or exception) into state
+template <typename R, typename F>
+void Fulfil(FutureState<R> &state, F &&f) {
+    try {
+        if constexpr (std::is_void<R>::value) {
+            f();
+            state.SetValue();
+        } else {
+            state.SetValue(f());
+        }
+    } catch (...) {
+        state.SetException(std::current_exception());
+    }
+}
+
+} // namespace detail
+
+template <typename T>
+class Future {
+public:
+    Future() = default;
+
+    explicit Future(std::shared_ptr<detail::FutureState<T>> state)
+        : _state(std::move(state)) {}
+
+    Future(Future &&) noexcept = default;
+    Future &operator=(Future &&) noexcept = default;
+
+    Future(const Future &) = delete;
+    Future &operator=(const Future &) = delete;
+
+public:
+    bool Valid() const {
+        return _state != nullptr;
+    }
+
+    bool Ready() const {
+        return _state != nullptr && _state->Ready();
+    }
+
+    void Wait() const {
+        _state->Wait();
+    }
+
+    template <typename Rep, typename Period>
+    bool WaitFor(const std::chrono::duration<Rep, Period> &timeout) const {
+        return _state->WaitFor(std::chrono::duration_cast<std::chrono::nanoseconds>(timeout));
+    }
+
+    // wait, then return the value or rethrow the exception
+    T Get() {
+        auto state = std::move(_state);
+        state->Wait();
+        if constexpr (std::is_void<T>::value) {
+            state->Value();
+        } else {
+            return std::move(state->Value());
+        }
+    }
+
+    // f(T) or f() for Future<void>, runs on the thread that completes this future
+    template <typename F>
+    auto Then(F &&f) {
+        using R = typename std::conditional<std::is_void<T>::value, std::invoke_result<F>,
+                                            std::invoke_result<F, T>>::type::type;
+        auto next = std::make_shared<detail::FutureState<R>>();
+        auto state = std::move(_state);
+        auto raw = state.get();
+        // the state runs (and then drops) its own continuation, capturing it raw avoids a cycle
+        raw->OnReady([raw, next, func = std::forward<F>(f)]() mutable {
+            if (raw->Error()) {
+                next->SetException(raw->Error());
+                return;
+            }
+            detail::Fulfil(*next, [&]() -> R {
+                if constexpr (std::is_void<T>::value) {
+                    return func();
+                } else {
+                    return func(std::move(raw->Value()));
+                }
+            });
+        });
+        return Future<R>(std::move(next));
+    }
+
+private:
+    std::shared_ptr<detail::FutureState<T>> _state;
+};
+
+template <typename T>
+class Promise {
+public:
+    Promise()
+        : _state(std::make_shared<detail::FutureState<T>>()) {}
+
+public:
+    Future<T> GetFuture() {
+        return Future<T>(_state);
+    }
+
+    template <typename... Args>
+    void SetValue(Args &&... args) {
+        _state->SetValue(std::forward<Args>(args)...);
+    }
+
+    void SetException(std::exception_ptr error) {
+        _state->SetException(std::move(error));
+    }
+
+private:
+    std::shared_ptr<detail::FutureState<T>> _state;
+};
+
+template <typename T>
+Future<typename std::decay<T>::type> MakeReadyFuture(T &&value) {
+    Promise<typename std::decay<T>::type> promise;
+    promise.SetValue(std::forward<T>(value));
+    return promise.GetFuture();
+}
+
+} // namespace scorpion
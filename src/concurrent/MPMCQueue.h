@@ -38,14 +38,14 @@ public:
         : capacity_(capacity < kDefaultCapacity ? kDefaultCapacity : capacity)
         , head_(0)
         , tail_(0) {
-        size_t space = capacity * sizeof(Slot) + kCacheLineSize - 1;
+        size_t space = capacity_ * sizeof(Slot) + kCacheLineSize - 1;
         buffer_ = malloc(space);
         if (buffer_ == nullptr) {
             throw std::bad_alloc();
         }
 
         void *buffer = buffer_;
-        slots_ = reinterpret_cast<Slot *>(std::align(kCacheLineSize, capacity * sizeof(Slot), buffer, space));
+        slots_ = reinterpret_cast<Slot *>(std::align(kCacheLineSize, capacity_ * sizeof(Slot), buffer, space));
 
         if (slots_ == nullptr) {
             free(buffer_);
@@ -136,6 +136,36 @@ public:
         }
     }
 
+    // move up to count items from first on with a single claim of consecutive slots, return the number pushed
+    template <typename It>
+    size_t TryPushBulk(It first, size_t count) noexcept {
+        static_assert(std::is_nothrow_constructible<T, decltype(std::move(*first))>::value,
+                      "T must be nothrow move constructible");
+        auto head = head_.load(std::memory_order_acquire);
+        while (true) {
+            size_t n = 0;
+            while (n < count && term(head + n) * 2 == slots_[idx(head + n)].term.load(std::memory_order_acquire)) {
+                ++n;
+            }
+            if (n == 0) {
+                auto const prevHead = head;
+                head = head_.load(std::memory_order_acquire);
+                if (head == prevHead) {
+                    return 0;
+                }
+                continue;
+            }
+            if (head_.compare_exchange_strong(head, head + n)) {
+                for (size_t i = 0; i < n; ++i, ++first) {
+                    auto &slot = slots_[idx(head + i)];
+                    slot.Construct(std::move(*first));
+                    slot.term.store(term(head + i) * 2 + 1, std::memory_order_release);
+                }
+                return n;
+            }
+        }
+    }
+
     void Pop(T &v) noexcept {
         auto const tail = tail_.fetch_add(1);
         auto &slot = slots_[idx(tail)];
@@ -167,6 +197,13 @@ public:
         }
     }
 
+    // approximate when called concurrently with Push/Pop
+    size_t Size() const noexcept {
+        auto const head = head_.load(std::memory_order_acquire);
+        auto const tail = tail_.load(std::memory_order_acquire);
+        return head > tail ? head - tail : 0;
+    }
+
 private:
     static_assert(std::is_nothrow_copy_assignable<T>::value || std::is_nothrow_move_assignable<T>::value,
                   "T must be nothrow copy or move assignable");
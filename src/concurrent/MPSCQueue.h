@@ -19,14 +19,14 @@ public:
         : capacity_(capacity < kDefaultCapacity ? kDefaultCapacity : capacity)
         , head_(0)
         , tail_(0) {
-        size_t space = capacity * sizeof(Slot) + kCacheLineSize - 1;
+        size_t space = capacity_ * sizeof(Slot) + kCacheLineSize - 1;
         buffer_ = malloc(space);
         if (buffer_ == nullptr) {
             throw std::bad_alloc();
         }
 
         void *buffer = buffer_;
-        slots_ = reinterpret_cast<Slot *>(std::align(kCacheLineSize, capacity * sizeof(Slot), buffer, space));
+        slots_ = reinterpret_cast<Slot *>(std::align(kCacheLineSize, capacity_ * sizeof(Slot), buffer, space));
 
         if (slots_ == nullptr) {
             free(buffer_);
@@ -146,11 +146,10 @@ public:
         if (head_.load(std::memory_order_acquire) == tail) {
             return nullptr;
         }
-        const auto slot = slots_[tail];
-        if (!slot.ready.load(std::memory_order_acquire)) {
+        if (!slots_[tail].ready.load(std::memory_order_acquire)) {
             return nullptr;
         }
-        return &slots_[tail];
+        return reinterpret_cast<T *>(&slots_[tail].storage);
     }
 
     void Pop() noexcept {
@@ -164,6 +163,18 @@ public:
         tail_.store(nextTail, std::memory_order_release);
     }
 
+    // approximate when called concurrently with Push/Pop
+    size_t Size() const noexcept {
+        auto const head = head_.load(std::memory_order_acquire);
+        auto const tail = tail_.load(std::memory_order_acquire);
+        return (head + capacity_ - tail) % capacity_;
+    }
+
+    // approximate when called concurrently with Push
+    bool Empty() const noexcept {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
     std::vector<T> TryPopBulk() noexcept {
         static_assert(std::is_nothrow_destructible<T>::value, "T must be nothrow destructible");
         auto const tail = tail_.load(std::memory_order_acquire);
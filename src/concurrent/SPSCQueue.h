@@ -109,7 +109,7 @@ public:
         auto const tail = tail_.load(std::memory_order_acquire);
         while (head_.load(std::memory_order_acquire) == tail) {
         }
-        v = slots_[tail + kPadding];
+        v = std::move(slots_[tail + kPadding]);
         slots_[tail + kPadding].~T();
         auto nextTail = tail + 1;
         if (nextTail == capacity_) {
@@ -124,7 +124,7 @@ public:
         if (head_.load(std::memory_order_acquire) == tail) {
             return false;
         }
-        v = slots_[tail + kPadding];
+        v = std::move(slots_[tail + kPadding]);
         slots_[tail + kPadding].~T();
         auto nextTail = tail + 1;
         if (nextTail == capacity_) {
@@ -154,6 +154,18 @@ public:
         tail_.store(nextTail, std::memory_order_release);
     }
 
+    // approximate when called concurrently with Push/Pop
+    size_t Size() const noexcept {
+        auto const head = head_.load(std::memory_order_acquire);
+        auto const tail = tail_.load(std::memory_order_acquire);
+        return head >= tail ? head - tail : head + capacity_ - tail;
+    }
+
+    // one slot is always kept empty to tell full from empty
+    size_t Capacity() const noexcept {
+        return capacity_ - 1;
+    }
+
 private:
     static constexpr size_t kDefaultCapacity = 256;
 
@@ -17,7 +17,7 @@ public:
 
 public:
     void lock() {
-        while (flag.test_and_set(std::memory_order::memory_order_acquire)) {
+        while (flag.test_and_set(std::memory_order_acquire)) {
         }
     }
     void unlock() {
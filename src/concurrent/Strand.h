@@ -0,0 +1,139 @@
+/**
+ * A strand: an unbounded lock-free multi-producer queue whose items are consumed serially by whichever
+ * thread currently owns it (intrusive mpsc list, D. Vyukov).
+ *
+ * Key Features:
+ * 0. Push() returns true when the strand turned from idle to runnable, the caller then hands the strand
+ *    to exactly one consumer (put it into a ready queue).
+ * 1. The owner pops at most Pending() items and calls Done(n); Done() returns true when more items
+ *    arrived meanwhile, the strand stays runnable and must be handed over again.
+ * 2. Ownership moves through Push()/Done() with acq_rel, so consecutive owners see each other's writes
+ *    and the items of one strand never run concurrently or out of order.
+ * 3. One node is allocated per item, PushBulk() links a whole chain with a single exchange.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <utility>
+
+namespace scorpion {
+
+template <typename T>
+class Strand {
+public:
+    Strand()
+        : _head(&_stub)
+        , _tail(&_stub)
+        , _pending(0) {}
+
+    ~Strand() {
+        T value;
+        while (TryPop(value)) {
+        }
+    }
+
+    Strand(const Strand &) = delete;
+    Strand &operator=(const Strand &) = delete;
+
+public:
+    // any thread
+    bool Push(T value) {
+        auto node = new Node(std::move(value));
+        link(node);
+        return _pending.fetch_add(1, std::memory_order_acq_rel) == 0;
+    }
+
+    // any thread, move count items from first on with one exchange and one counter update
+    template <typename It>
+    bool PushBulk(It first, size_t count) {
+        if (count == 0) {
+            return false;
+        }
+        auto head = new Node(std::move(*first));
+        auto tail = head;
+        for (size_t i = 1; i < count; ++i) {
+            auto node = new Node(std::move(*++first));
+            tail->next.store(node, std::memory_order_relaxed);
+            tail = node;
+        }
+        auto prev = _head.exchange(tail, std::memory_order_acq_rel);
+        prev->next.store(head, std::memory_order_release);
+        return _pending.fetch_add(count, std::memory_order_acq_rel) == 0;
+    }
+
+    // owner only, blocks through the short window in which a producer has not linked its node yet
+    void Pop(T &value) {
+        while (!TryPop(value)) {
+            std::this_thread::yield();
+        }
+    }
+
+    // owner only
+    bool TryPop(T &value) {
+        auto tail = _tail;
+        auto next = tail->next.load(std::memory_order_acquire);
+        if (tail == &_stub) {
+            if (next == nullptr) {
+                return false;
+            }
+            _tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next == nullptr) {
+            if (tail != _head.load(std::memory_order_acquire)) {
+                return false; // a producer is in the middle of link()
+            }
+            link(&_stub);
+            next = tail->next.load(std::memory_order_acquire);
+            if (next == nullptr) {
+                return false;
+            }
+        }
+        _tail = next;
+        value = std::move(tail->value);
+        delete tail;
+        return true;
+    }
+
+    // owner only, return true if the strand is still runnable
+    bool Done(size_t count) {
+        return _pending.fetch_sub(count, std::memory_order_acq_rel) > count;
+    }
+
+    size_t Pending() const {
+        return _pending.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Node {
+        Node()
+            : next(nullptr) {}
+
+        explicit Node(T v)
+            : value(std::move(v))
+            , next(nullptr) {}
+
+        T value;
+        std::atomic<Node *> next;
+    };
+
+    void link(Node *node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        auto prev = _head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+private:
+    static constexpr size_t kCacheLineSize = 64;
+
+    alignas(kCacheLineSize) std::atomic<Node *> _head;
+    alignas(kCacheLineSize) Node *_tail;
+    Node _stub;
+    alignas(kCacheLineSize) std::atomic<size_t> _pending;
+};
+
+} // namespace scorpion
@@ -0,0 +1,148 @@
+/**
+ * A Chase-Lev work-stealing deque (the C11 version by Le, Pop, Cohen and Zappa Nardelli).
+ *
+ * The owner thread pushes and pops at the bottom (LIFO), any other thread steals from
+ * the top (FIFO). The ring grows when full, retired rings are released in the destructor
+ * since a thief may still read from them. T must be trivially copyable, store pointers
+ * for anything else.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace scorpion {
+
+template <typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(size_t capacity = kDefaultCapacity)
+        : _top(0)
+        , _bottom(0)
+        , _ring(new Ring(roundup(capacity))) {
+        _retired.emplace_back(_ring.load(std::memory_order_relaxed));
+    }
+
+    ~WorkStealingDeque() = default;
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+public:
+    // owner only
+    void Push(T v) noexcept {
+        auto const b = _bottom.load(std::memory_order_relaxed);
+        auto const t = _top.load(std::memory_order_acquire);
+        auto ring = _ring.load(std::memory_order_relaxed);
+        if (b - t > ring->mask) {
+            ring = grow(ring, t, b);
+        }
+        ring->Put(b, v);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // owner only
+    bool TryPop(T &v) noexcept {
+        auto const b = _bottom.load(std::memory_order_relaxed) - 1;
+        auto ring = _ring.load(std::memory_order_relaxed);
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = _top.load(std::memory_order_relaxed);
+        if (t > b) {
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        v = ring->Get(b);
+        if (t == b) {
+            // the last element, race against the thieves
+            bool won = _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // any thread, false when empty or when losing a race (just try another victim)
+    bool TrySteal(T &v) noexcept {
+        auto t = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto const b = _bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return false;
+        }
+        auto ring = _ring.load(std::memory_order_acquire);
+        auto const x = ring->Get(t);
+        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return false;
+        }
+        v = x;
+        return true;
+    }
+
+    // approximate
+    size_t Size() const noexcept {
+        auto const b = _bottom.load(std::memory_order_relaxed);
+        auto const t = _top.load(std::memory_order_relaxed);
+        return b > t ? (size_t)(b - t) : 0;
+    }
+
+    bool Empty() const noexcept {
+        return Size() == 0;
+    }
+
+private:
+    static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+
+    struct Ring {
+        explicit Ring(size_t capacity)
+            : mask((int64_t)capacity - 1)
+            , slots(new std::atomic<T>[capacity]) {}
+
+        T Get(int64_t i) const noexcept {
+            return slots[i & mask].load(std::memory_order_relaxed);
+        }
+
+        void Put(int64_t i, T v) noexcept {
+            slots[i & mask].store(v, std::memory_order_relaxed);
+        }
+
+        const int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    static size_t roundup(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    Ring *grow(Ring *ring, int64_t t, int64_t b) {
+        auto bigger = new Ring((size_t)(ring->mask + 1) * 2);
+        for (auto i = t; i < b; ++i) {
+            bigger->Put(i, ring->Get(i));
+        }
+        _retired.emplace_back(bigger);
+        _ring.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+private:
+    static constexpr size_t kDefaultCapacity = 256;
+    static constexpr size_t kCacheLineSize = 128;
+
+private:
+    // Align to avoid false sharing between the thieves (top) and the owner (bottom)
+    alignas(kCacheLineSize) std::atomic<int64_t> _top;
+    alignas(kCacheLineSize) std::atomic<int64_t> _bottom;
+    std::atomic<Ring *> _ring;
+    std::vector<std::unique_ptr<Ring>> _retired; // owner only
+};
+
+} // namespace scorpion
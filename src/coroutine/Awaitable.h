@@ -0,0 +1,253 @@
+/**
+ * Awaitables for coro::Task<T> (C++20) over the existing pools, timer wheel and sockets.
+ *
+ * Key Features:
+ * 0. co_await Schedule(pool) moves the coroutine onto a ThreadPool or AsyncTaskPool manager,
+ *    it keeps running inline if the pool rejects it.
+ * 1. co_await SleepFor(wheel, interval) resumes after interval ticks, use an async TimeWheel so the
+ *    coroutine resumes on its pool and not on the ticking thread (which holds the wheel's mutex).
+ * 2. IoContext runs an Epoller on its own thread, co_await io.Readable(fd)/Writable(fd) resumes the
+ *    coroutine on that thread once fd is ready; one waiter per fd at a time.
+ * 3. AsyncRecv/AsyncSend move exactly length bytes over a UnixSocket without blocking a thread.
+ *
+ */
+
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "AsyncTaskPool.h"
+#include "Epoller.h"
+#include "EventQueue.h"
+#include "Task.h"
+#include "ThreadPool.h"
+#include "TimeWheel.h"
+#include "UnixSocket.h"
+
+namespace scorpion {
+namespace coro {
+
+namespace detail {
+
+template <typename Submit>
+struct ScheduleAwaiter {
+    Submit submit;
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    // false resumes the coroutine right here
+    bool await_suspend(std::coroutine_handle<> handle) {
+        return submit([handle]() {
+            handle.resume();
+            return 0;
+        });
+    }
+
+    void await_resume() const noexcept {}
+};
+
+template <typename Submit>
+ScheduleAwaiter<Submit> MakeScheduleAwaiter(Submit submit) {
+    return ScheduleAwaiter<Submit>{std::move(submit)};
+}
+
+} // namespace detail
+
+inline auto Schedule(ThreadPool &pool) {
+    // never blocks: a coroutine already on a worker would hold that worker while the queue is full
+    return detail::MakeScheduleAwaiter([&pool](InplaceFunction<int()> fn) { return pool.TryPush(std::move(fn)); });
+}
+
+template <typename QUEUE>
+auto Schedule(Manager<scorpion::Task, QUEUE> &pool, unsigned uid = 0) {
+    return detail::MakeScheduleAwaiter([&pool, uid](scorpion::Task::Func fn) {
+        return pool.Submit(uid, scorpion::Task(uid, std::chrono::steady_clock::now(), std::move(fn)));
+    });
+}
+
+template <typename Resolution>
+auto SleepFor(TimeWheel<Resolution> &wheel, unsigned interval) {
+    struct Awaiter {
+        TimeWheel<Resolution> &wheel;
+        unsigned interval;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            wheel.Add(
+                [handle]() {
+                    handle.resume();
+                    return 0;
+                },
+                interval, 1);
+        }
+
+        void await_resume() const noexcept {}
+    };
+    return Awaiter{wheel, interval};
+}
+
+class IoContext {
+public:
+    IoContext()
+        : _requests(kRequestCapacity)
+        , _running(false) {}
+
+    ~IoContext() {
+        Stop();
+    }
+
+    IoContext(const IoContext &) = delete;
+    IoContext &operator=(const IoContext &) = delete;
+
+public:
+    bool Start() {
+        if (_running.exchange(true)) {
+            printf("[Warn] io context is running\n");
+            return false;
+        }
+        if (_poller.Create() != 0 ||
+            _poller.Add(_requests.Fd(), EPOLLIN, [this](uint32_t) { _requests.Consume([this](Waiter w) { arm(w); }); }) !=
+                0) {
+            _running = false;
+            return false;
+        }
+        _thread = std::thread([this]() {
+            while (_running.load(std::memory_order_acquire)) {
+                _poller.Poll(kPollTimeoutMs);
+            }
+        });
+        return true;
+    }
+
+    // waiters still suspended are never resumed, stop after the flows finished
+    void Stop() {
+        if (!_running.exchange(false)) {
+            return;
+        }
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+        _poller.Destroy();
+    }
+
+    auto Readable(int fd) {
+        return Awaiter{this, fd, EPOLLIN | EPOLLRDHUP};
+    }
+
+    auto Writable(int fd) {
+        return Awaiter{this, fd, EPOLLOUT};
+    }
+
+private:
+    struct Waiter {
+        int fd = -1;
+        uint32_t events = 0;
+        std::coroutine_handle<> handle;
+    };
+
+    struct Awaiter {
+        IoContext *io;
+        int fd;
+        uint32_t events;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            if (!io->_requests.TryPush(Waiter{fd, events, handle})) {
+                printf("[Warn] io requests are full\n");
+                return false;
+            }
+            return true;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    // loop thread only
+    void arm(const Waiter &w) {
+        auto ret = _poller.Add(w.fd, w.events, [this, w](uint32_t) {
+            _poller.Del(w.fd);
+            w.handle.resume();
+        });
+        if (ret != 0) {
+            // let the coroutine retry rather than hang
+            w.handle.resume();
+        }
+    }
+
+private:
+    static constexpr size_t kRequestCapacity = 4096;
+    static constexpr int kPollTimeoutMs = 100;
+
+    Scorpion::Epoller _poller;
+    EventQueue<Waiter> _requests;
+    std::atomic<bool> _running;
+    std::thread _thread;
+};
+
+// receive exactly length bytes, return length or -1 (error or closed by peer)
+inline Task<int> AsyncRecv(IoContext &io, Scorpion::UnixSocket &sox, void *buffer, size_t length) {
+    auto cursor = static_cast<char *>(buffer);
+    size_t done = 0;
+    while (done < length) {
+        auto byte = recv(sox.GetFd(), cursor + done, length - done, MSG_DONTWAIT);
+        if (byte > 0) {
+            done += (size_t)byte;
+            continue;
+        }
+        if (byte == 0) {
+            printf("closed by peer\n");
+            co_return -1;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            printf("read err %d %s\n", errno, strerror(errno));
+            co_return -1;
+        }
+        co_await io.Readable(sox.GetFd());
+    }
+    co_return (int)done;
+}
+
+// send exactly length bytes, return length or -1
+inline Task<int> AsyncSend(IoContext &io, Scorpion::UnixSocket &sox, const void *buffer, size_t length) {
+    auto cursor = static_cast<const char *>(buffer);
+    size_t done = 0;
+    while (done < length) {
+        auto byte = send(sox.GetFd(), cursor + done, length - done, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (byte > 0) {
+            done += (size_t)byte;
+            continue;
+        }
+        if (byte < 0 && errno == EINTR) {
+            continue;
+        }
+        if (byte < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            printf("write err %d %s\n", errno, strerror(errno));
+            co_return -1;
+        }
+        co_await io.Writable(sox.GetFd());
+    }
+    co_return (int)done;
+}
+
+} // namespace coro
+} // namespace scorpion
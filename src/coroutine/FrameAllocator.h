@@ -0,0 +1,100 @@
+/**
+ * A pooled allocator for coroutine frames.
+ *
+ * Key Features:
+ * 0. Frames are rounded up to 64 bytes size classes (up to 4KB), larger ones go to operator new.
+ * 1. Every thread caches freed blocks per size class without any lock, a frame resumed and freed
+ *    on another thread simply lands in that thread's cache.
+ * 2. A cache keeps at most kMaxCached blocks per class, the rest goes back to operator delete.
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace scorpion {
+
+class FrameAllocator {
+public:
+    static void *Allocate(size_t size) {
+        auto cls = sizeClass(size);
+        if (cls >= kClasses) {
+            return ::operator new(size);
+        }
+        auto &list = cache().lists[cls];
+        if (list.head != nullptr) {
+            auto block = list.head;
+            list.head = block->next;
+            --list.count;
+            return block;
+        }
+        return ::operator new((cls + 1) * kGranularity);
+    }
+
+    static void Deallocate(void *ptr, size_t size) noexcept {
+        auto cls = sizeClass(size);
+        if (cls >= kClasses) {
+            ::operator delete(ptr);
+            return;
+        }
+        auto &list = cache().lists[cls];
+        if (list.count >= kMaxCached) {
+            ::operator delete(ptr);
+            return;
+        }
+        auto block = static_cast<Block *>(ptr);
+        block->next = list.head;
+        list.head = block;
+        ++list.count;
+    }
+
+    // blocks cached by the calling thread
+    static size_t Cached() {
+        size_t count = 0;
+        for (auto &list : cache().lists) {
+            count += list.count;
+        }
+        return count;
+    }
+
+private:
+    static constexpr size_t kGranularity = 64;
+    static constexpr size_t kClasses = 64;
+    static constexpr size_t kMaxCached = 1024;
+
+    struct Block {
+        Block *next;
+    };
+
+    struct FreeList {
+        Block *head = nullptr;
+        size_t count = 0;
+    };
+
+    struct Cache {
+        FreeList lists[kClasses];
+
+        ~Cache() {
+            for (auto &list : lists) {
+                while (list.head != nullptr) {
+                    auto block = list.head;
+                    list.head = block->next;
+                    ::operator delete(block);
+                }
+            }
+        }
+    };
+
+    static size_t sizeClass(size_t size) {
+        return size == 0 ? 0 : (size - 1) / kGranularity;
+    }
+
+    static Cache &cache() {
+        static thread_local Cache cache;
+        return cache;
+    }
+};
+
+} // namespace scorpion
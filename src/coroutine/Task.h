@@ -0,0 +1,262 @@
+/**
+ * A lazy coroutine coro::Task<T> (C++20), see Awaitable.h for what it can wait on.
+ * It lives in scorpion::coro since scorpion::Task is the AsyncTaskPool task.
+ *
+ * Key Features:
+ * 0. A Task starts when it is co_awaited and resumes its awaiter by symmetric transfer when done,
+ *    no continuation is allocated (the transfer is only a tail call in optimized builds, a -O0
+ *    build grows the stack with every task awaited in a row).
+ * 1. Exceptions are rethrown at the co_await (or by Future::Get for ToFuture/SyncWait).
+ * 2. Frames come from FrameAllocator.
+ * 3. Spawn() starts a Task<void> detached, ToFuture() bridges into Future.h, SyncWait() blocks on it.
+ *
+ */
+
+#pragma once
+
+#include <coroutine>
+#include <cstdio>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "FrameAllocator.h"
+#include "Future.h"
+
+namespace scorpion {
+namespace coro {
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct PromiseBase {
+    struct FinalAwaiter {
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept {
+            return handle.promise()._continuation;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() const noexcept {
+        return {};
+    }
+
+    void unhandled_exception() noexcept {
+        _error = std::current_exception();
+    }
+
+    static void *operator new(size_t size) {
+        return FrameAllocator::Allocate(size);
+    }
+
+    static void operator delete(void *ptr, size_t size) noexcept {
+        FrameAllocator::Deallocate(ptr, size);
+    }
+
+    std::coroutine_handle<> _continuation = std::noop_coroutine();
+    std::exception_ptr _error;
+};
+
+template <typename T>
+struct TaskPromise : PromiseBase {
+    Task<T> get_return_object() noexcept;
+
+    template <typename V>
+    void return_value(V &&value) {
+        _value.emplace(std::forward<V>(value));
+    }
+
+    T Result() {
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+        return std::move(*_value);
+    }
+
+    std::optional<T> _value;
+};
+
+template <>
+struct TaskPromise<void> : PromiseBase {
+    Task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+
+    void Result() {
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+    }
+};
+
+// a started-and-forgotten coroutine which frees its own frame
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() const noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept {
+            return {};
+        }
+
+        void return_void() const noexcept {}
+
+        void unhandled_exception() const noexcept {
+            std::terminate();
+        }
+
+        static void *operator new(size_t size) {
+            return FrameAllocator::Allocate(size);
+        }
+
+        static void operator delete(void *ptr, size_t size) noexcept {
+            FrameAllocator::Deallocate(ptr, size);
+        }
+    };
+};
+
+} // namespace detail
+
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+public:
+    Task() = default;
+
+    explicit Task(std::coroutine_handle<promise_type> handle)
+        : _handle(handle) {}
+
+    Task(Task &&other) noexcept
+        : _handle(std::exchange(other._handle, nullptr)) {}
+
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            reset();
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task() {
+        reset();
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+public:
+    bool Valid() const {
+        return _handle != nullptr;
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() const noexcept {
+                return handle == nullptr || handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+                handle.promise()._continuation = awaiter;
+                return handle;
+            }
+
+            T await_resume() {
+                return handle.promise().Result();
+            }
+        };
+        return Awaiter{_handle};
+    }
+
+private:
+    void reset() {
+        if (_handle != nullptr) {
+            _handle.destroy();
+            _handle = nullptr;
+        }
+    }
+
+private:
+    std::coroutine_handle<promise_type> _handle;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+template <typename T>
+Detached RunInto(Task<T> task, Promise<T> promise) {
+    try {
+        if constexpr (std::is_void<T>::value) {
+            co_await std::move(task);
+            promise.SetValue();
+        } else {
+            promise.SetValue(co_await std::move(task));
+        }
+    } catch (...) {
+        promise.SetException(std::current_exception());
+    }
+}
+
+inline Detached RunDetached(Task<void> task) {
+    try {
+        co_await std::move(task);
+    } catch (std::exception &e) {
+        printf("[Warn] coroutine throw exception %s\n", e.what());
+    } catch (...) {
+        printf("[Warn] coroutine throw non-std::exception\n");
+    }
+}
+
+} // namespace detail
+
+// start task on the calling thread, it runs until its first suspension
+inline void Spawn(Task<void> task) {
+    detail::RunDetached(std::move(task));
+}
+
+// start task on the calling thread, the future completes wherever it finishes
+template <typename T>
+Future<T> ToFuture(Task<T> task) {
+    Promise<T> promise;
+    auto future = promise.GetFuture();
+    detail::RunInto(std::move(task), std::move(promise));
+    return future;
+}
+
+// start task and block until it finished, for main() and tests
+template <typename T>
+T SyncWait(Task<T> task) {
+    return ToFuture(std::move(task)).Get();
+}
+
+} // namespace coro
+} // namespace scorpion
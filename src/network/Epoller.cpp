@@ -0,0 +1,94 @@
+#include "Epoller.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace Scorpion {
+
+Epoller::Epoller()
+    : _epfd(-1)
+    , _events(MAX_EVENTS) {}
+
+Epoller::~Epoller() {
+    Destroy();
+}
+
+int Epoller::Create() {
+    if (_epfd != -1) {
+        return -1;
+    }
+    _epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epfd == -1) {
+        printf("epoll create err %d %s\n", errno, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int Epoller::Destroy() {
+    if (_epfd != -1) {
+        close(_epfd);
+        _epfd = -1;
+    }
+    _callbacks.clear();
+    return 0;
+}
+
+int Epoller::Add(int fd, uint32_t events, Callback cb) {
+    epoll_event ev{};
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(_epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        printf("epoll add %d err %d %s\n", fd, errno, strerror(errno));
+        return -1;
+    }
+    _callbacks[fd] = std::make_shared<Callback>(std::move(cb));
+    return 0;
+}
+
+int Epoller::Mod(int fd, uint32_t events) {
+    epoll_event ev{};
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(_epfd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        printf("epoll mod %d err %d %s\n", fd, errno, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int Epoller::Del(int fd) {
+    if (epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, nullptr) == -1) {
+        printf("epoll del %d err %d %s\n", fd, errno, strerror(errno));
+        return -1;
+    }
+    _callbacks.erase(fd);
+    return 0;
+}
+
+int Epoller::Poll(int timeout) {
+    int ret = epoll_wait(_epfd, _events.data(), (int)_events.size(), timeout);
+    if (ret == -1) {
+        if (errno != EINTR) {
+            printf("epoll wait err %d %s\n", errno, strerror(errno));
+            return -1;
+        }
+        return 0;
+    }
+    for (int idx = 0; idx < ret; ++idx) {
+        // a callback may have removed a later fd of the same batch, or itself
+        auto iter = _callbacks.find(_events[(size_t)idx].data.fd);
+        if (iter != _callbacks.end()) {
+            auto cb = iter->second;
+            (*cb)(_events[(size_t)idx].events);
+        }
+    }
+    return ret;
+}
+
+} // namespace Scorpion
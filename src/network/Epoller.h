@@ -0,0 +1,47 @@
+/**
+ * A tiny level-triggered epoll wrapper which dispatches readiness to callbacks.
+ * Not thread safe, Add/Mod/Del/Poll are expected to run on the loop thread.
+ *
+ */
+
+#pragma once
+
+#include <sys/epoll.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Scorpion {
+
+class Epoller {
+public:
+    using Callback = std::function<void(uint32_t events)>;
+
+public:
+    Epoller();
+    ~Epoller();
+
+    Epoller(const Epoller &) = delete;
+    Epoller &operator=(const Epoller &) = delete;
+
+public:
+    int Create();
+    int Destroy();
+    int Add(int fd, uint32_t events, Callback cb);
+    int Mod(int fd, uint32_t events);
+    int Del(int fd);
+    // wait at most timeout ms (-1 forever) and run the callbacks, return the number of events
+    int Poll(int timeout);
+
+protected:
+    enum { MAX_EVENTS = 64 };
+
+    int _epfd;
+    std::unordered_map<int, std::shared_ptr<Callback>> _callbacks;
+    std::vector<epoll_event> _events;
+};
+
+} // namespace Scorpion
@@ -90,6 +90,10 @@ int UnixSocket::Recv(void *buffer, size_t length) {
     return (int)recvPacket(getSox(), buffer, length);
 }
 
+int UnixSocket::GetFd() const {
+    return _sox;
+}
+
 int UnixSocket::getSox() const {
     return _sox;
 }
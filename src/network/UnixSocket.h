@@ -26,6 +26,8 @@ public:
     int Destroy();
     int Send(const void *buffer, size_t length);
     int Recv(void *buffer, size_t length);
+    // the underlying descriptor, eg: to wait on it with Epoller
+    int GetFd() const;
 
 protected:
     int getSox() const;
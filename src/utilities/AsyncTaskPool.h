@@ -2,52 +2,108 @@
  * specialization version: Worker has a private mpmc queue and observes another one.
  *
  * Key Features:
- * 0. Timeout task will be ignored.
+ * 0. Timeout, cancelled or expired (past its deadline) task will be ignored at dequeue, see TaskContext.
  * 1. mpmc + stealing -> task is executed out of order.
- * 2. Submitted task will be assigned with the round-robin algorithm.
+ * 2. Submitted task goes to the shorter of two queues picked at random (power of two choices), each
+ *    producer thread draws from its own generator so submitters share no cache line to route.
  * 3. Each worker has its own queue, it also can steal task from next worker if necessary.
  * 4. Worker can be reused as "Start()->Stop()->Start()->..." (better not do that).
  * 5. Call Stop(clean = true) to make sure no task is left behind (destructor will not do that).
+ * 6. An idle worker spins, yields, then parks (at most sleep ms, 0: until woken); Submit wakes the owner
+ *    of the queue or, if that one is busy, the worker stealing from it, only when it is parked.
+ * 7. SubmitBulk() routes once and claims a run of slots per queue with a single CAS.
+ * 8. SetBackpressure() picks what Submit and SubmitBulk do when every queue is full (see Backpressure.h),
+ *    Rejections() counts what happened.
+ * 9. SubmitAfter()/SubmitEvery() arm a timer on the routed worker (see TimerQueue.h), which checks it
+ *    between tasks and runs the task itself when due; a periodic task stops once its token is cancelled,
+ *    timers still pending are dropped by Stop().
+ * 10. SetPlacement() pins the workers along the cpu topology and names their threads (see ThreadAffinity.h),
+ *     a pinned worker steals from every other queue, the workers nearest in cache first.
  *
  */
 
 /**
- * specialization version: Worker has a private mpmc queue.
+ * specialization version: Workers share a ready queue of strands (MPSCQueue<Task> only names the version).
  *
  * Key Features:
- * 0. Timeout task will be ignored.
- * 1. mpsc -> task of the same queue is executed in order.
- * 2. Submitted task will be assigned with the hash algorithm.
- * 3. Each worker has its own queue which is private.
+ * 0. Timeout, cancelled or expired (past its deadline) task will be ignored at dequeue, see TaskContext.
+ * 1. strand -> tasks of the same uid are executed in order, never two at a time.
+ * 2. Submitted task goes to strand uid % (pool_size * kStrandsPerWorker), keys sharing a strand are
+ *    serialized together, a strand holds at most queue_len pending tasks.
+ * 3. A strand becomes runnable with its first pending task and is picked up by any idle worker, which
+ *    runs a batch of it and hands it back to the ready queue if more is pending; a hot or slow key
+ *    occupies one worker at a time and no longer blocks the other keys of a worker.
  * 4. Worker can be reused as "Start()->Stop()->Start()->..." (better not do that).
  * 5. Call Stop(clean = true) to make sure no task is left behind (destructor will not do that).
+ * 6. An idle worker spins, yields, then parks (at most sleep ms, 0: until woken); a strand turning
+ *    runnable wakes one parked worker, if any.
+ * 7. SubmitBulk() appends a whole batch of one uid to its strand with a single exchange.
+ * 8. SetBackpressure() picks what Submit and SubmitBulk do when the strand is full (kDropOldest acts as
+ *    kDropNewest, kCallerRuns runs the task ahead of the ones still pending on its strand).
+ * 9. SubmitAfter()/SubmitEvery() arm a timer on worker uid % pool_size, which queues the task on the
+ *    strand of uid when due, so timed tasks keep the order of their uid; a periodic task stops once its
+ *    token is cancelled, timers still pending are dropped by Stop().
+ * 10. SubmitCoalesce() folds a task into a pending one of the same uid and key (latest wins), through a
+ *     small index per strand, so duplicate submits under a storm run once.
+ * 11. SetPlacement() pins the workers along the cpu topology and names their threads (see ThreadAffinity.h).
  *
  */
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <exception>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "AsyncTaskPoolTemplate.h"
+#include "Backpressure.h"
+#include "CancelToken.h"
+#include "Executor.h"
+#include "InplaceFunction.h"
 #include "MPMCQueue.h"
 #include "MPSCQueue.h"
+#include "Parker.h"
+#include "SpinLockMutex.h"
+#include "Strand.h"
+#include "ThreadAffinity.h"
+#include "TimerQueue.h"
 
 namespace scorpion {
 
 class Task {
+public:
+    using Func = InplaceFunction<int()>;
+    using TimePoint = std::chrono::time_point<std::chrono::steady_clock>;
+
 public:
     Task()
         : _id(0)
-        , _ts(std::chrono::steady_clock::now()) {}
+        , _ts(std::chrono::steady_clock::now())
+        , _deadline(TimePoint::max()) {}
 
-    Task(unsigned id, std::chrono::time_point<std::chrono::steady_clock> ts, std::function<int()> func)
+    Task(unsigned id, TimePoint ts, Func func)
         : _id(id)
         , _ts(ts)
+        , _deadline(TimePoint::max())
+        , _func(std::move(func)) {}
+
+    // the task is dropped at dequeue once token is cancelled or deadline has passed
+    Task(unsigned id, TimePoint ts, Func func, CancelToken token, TimePoint deadline = TimePoint::max())
+        : _id(id)
+        , _ts(ts)
+        , _deadline(deadline)
+        , _token(std::move(token))
         , _func(std::move(func)) {}
 
     // non copyable
@@ -58,21 +114,129 @@ public:
     Task(Task &&t) noexcept {
         _id = t._id;
         _ts = t._ts;
+        _deadline = t._deadline;
+        _token = std::move(t._token);
         _func = std::move(t._func);
     }
     Task &operator=(Task &&t) noexcept {
         _id = t._id;
         _ts = t._ts;
+        _deadline = t._deadline;
+        _token = std::move(t._token);
         _func = std::move(t._func);
         return *this;
     }
 
+public:
+    bool Cancelled() const {
+        return _token.Cancelled();
+    }
+
+    bool Expired(TimePoint now) const {
+        return now >= _deadline;
+    }
+
 public:
     unsigned _id;
-    std::chrono::time_point<std::chrono::steady_clock> _ts;
-    std::function<int()> _func;
+    TimePoint _ts;
+    TimePoint _deadline;
+    CancelToken _token;
+    Func _func;
+};
+
+// xorshift32 with a state per producer thread, for routing only
+inline uint32_t RouteRandom() {
+    static thread_local uint32_t state =
+        (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id()) | 1u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+inline bool RunTask(const Task &task, unsigned timeout);
+
+// what a running task can ask about itself, outside of a pool task it is never cancelled and has no deadline
+class TaskContext {
+public:
+    static const Task *Current() {
+        return current();
+    }
+
+    // the caller gave up or the deadline has passed, stop early
+    static bool Cancelled() {
+        auto task = current();
+        return task != nullptr && (task->Cancelled() || task->Expired(std::chrono::steady_clock::now()));
+    }
+
+    static Task::TimePoint Deadline() {
+        auto task = current();
+        return task != nullptr ? task->_deadline : Task::TimePoint::max();
+    }
+
+    // time left before the deadline, nanoseconds::max() without one
+    static std::chrono::nanoseconds Remaining() {
+        auto deadline = Deadline();
+        if (deadline == Task::TimePoint::max()) {
+            return std::chrono::nanoseconds::max();
+        }
+        return std::max(std::chrono::nanoseconds(0), deadline - std::chrono::steady_clock::now());
+    }
+
+private:
+    friend bool RunTask(const Task &task, unsigned timeout);
+
+    static const Task *&current() {
+        static thread_local const Task *task = nullptr;
+        return task;
+    }
 };
 
+// run task unless it waited longer than timeout ms, was cancelled or missed its deadline; return false if dropped
+inline bool RunTask(const Task &task, unsigned timeout) {
+    auto now = std::chrono::steady_clock::now();
+    if (task.Cancelled()) {
+        return false;
+    }
+    if (task.Expired(now)) {
+        printf("[Warn] task deadline %u missed\n", task._id);
+        return false;
+    }
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(now - task._ts).count();
+    if (wait >= timeout) {
+        printf("[Warn] task timeout %u wait %ld ms\n", task._id, wait);
+        return false;
+    }
+    auto &current = TaskContext::current();
+    auto outer = current;
+    current = &task;
+    try {
+        task._func();
+    } catch (std::exception &e) {
+        printf("[Warn] task throw exception %s\n", e.what());
+    } catch (...) {
+        printf("[Warn] task throw non-std::exception\n");
+    }
+    current = outer;
+    return true;
+}
+
+// where the workers of a Manager run, call SetPlacement() before Init()
+struct PlacementOptions {
+    bool pin = false; // worker i on CpuTopology::Get().PlacementOrder()[i % size], steal victims by distance
+    std::string name; // worker i is named name + i (eg: "ingest3"), empty keeps the inherited name
+};
+
+// pin and name the calling worker thread, a cpu it may not use only costs a warning
+inline void PlaceWorker(unsigned id, int cpu, const std::string &name) {
+    if (cpu >= 0 && !PinCpu(cpu)) {
+        printf("[Warn] worker %u cannot be pinned to cpu %d\n", id, cpu);
+    }
+    if (!name.empty()) {
+        SetThreadName(name + std::to_string(id));
+    }
+}
+
 } // namespace scorpion
 
 namespace scorpion {
@@ -88,13 +252,17 @@ public:
         , _sleep(sleep)
         , _timeout(timeout)
         , _local(local)
-        , _steal(steal)
+        , _cpu(-1)
         , _running(false) {
         assert(local != nullptr);
+        if (steal != nullptr) {
+            _victims.push_back(steal);
+        }
     }
 
     virtual ~Worker() {
         _running = false;
+        _parker.Unpark();
         if (_thread.joinable()) {
             _thread.join();
         }
@@ -108,21 +276,29 @@ public:
         }
         _running = true;
         _thread = std::thread([this]() {
+            current() = this;
+            PlaceWorker(_id, _cpu, _name);
+            auto ready = [this]() {
+                return !_running || _local->Size() > 0 || _timers.Incoming() ||
+                       std::any_of(_victims.begin(), _victims.end(), [](queue *q) { return q->Size() > 0; });
+            };
+            unsigned idle = 0;
             while (_running) {
+                if (fire() > 0) {
+                    idle = 0;
+                }
                 Task task;
                 if (_local->TryPop(task)) {
                     execute(task);
+                    idle = 0;
                     continue;
                 }
-                if (_steal != nullptr && _steal->TryPop(task)) {
+                if (steal(task)) {
                     execute(task);
+                    idle = 0;
                     continue;
                 }
-                if (_sleep > 0) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(_sleep));
-                } else {
-                    std::this_thread::yield();
-                }
+                _parker.Idle(idle, ready, park());
             }
         });
         return true;
@@ -134,6 +310,7 @@ public:
             return false;
         }
         _running = false;
+        _parker.Unpark();
         if (_thread.joinable()) {
             _thread.join();
         }
@@ -143,17 +320,19 @@ public:
                 execute(task);
             }
         }
+        // timers are not tasks yet, they die with the run
+        _timers.Clear();
         return true;
     }
 
-    virtual bool Add(Task task) {
+    // task is moved from only if it was accepted
+    virtual bool Add(Task &&task) {
         if (_local == nullptr) {
             return false;
         }
         unsigned count = 0;
         while (!_local->TryPush(std::move(task))) {
             if (++count > 3) {
-                printf("[Warn] queue %u is full\n", _id);
                 return false;
             }
             std::this_thread::yield();
@@ -161,22 +340,90 @@ public:
         return true;
     }
 
+    // discard the oldest task of the own queue to make room
+    virtual bool DropOldest() {
+        Task task;
+        return _local != nullptr && _local->TryPop(task);
+    }
+
+    // push a prefix of tasks with one claim, return its length
+    virtual size_t AddBulk(Task *tasks, size_t count) {
+        return _local == nullptr ? 0 : _local->TryPushBulk(tasks, count);
+    }
+
+    // run task on this worker at due, then every period if period is not zero, until it is cancelled
+    virtual bool AddTimer(Task::TimePoint due, std::chrono::milliseconds period, Task &&task) {
+        if (!_running) {
+            printf("[Warn] worker %u is not running\n", _id);
+            return false;
+        }
+        _timers.Add(due, period, std::move(task));
+        _parker.Unpark();
+        return true;
+    }
+
+    // before Start(): cpu to pin the thread to (-1: float), thread name prefix (empty: keep)
+    void Place(int cpu, const std::string &name) {
+        _cpu = cpu;
+        _name = name;
+    }
+
+    // before Start(): the queues to steal from, nearest first (default: the one given to the constructor)
+    void SetVictims(std::vector<queue *> victims) {
+        _victims = std::move(victims);
+    }
+
+    // wake the worker if it is parked, return false if it was not
+    bool Unpark() {
+        return _parker.Unpark();
+    }
+
+    // the worker running on this thread, nullptr off the pool
+    static const Worker *Current() {
+        return current();
+    }
+
 protected:
+    static const Worker *&current() {
+        static thread_local const Worker *worker = nullptr;
+        return worker;
+    }
+
     virtual void execute(const Task &task) {
-        auto now = std::chrono::steady_clock::now();
-        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(now - task._ts).count();
-        if (wait < _timeout) {
-            try {
-                task._func();
-            } catch (std::exception &e) {
-                printf("[Warn] task throw exception %s\n", e.what());
-            } catch (...) {
-                printf("[Warn] task throw non-std::exception\n");
+        RunTask(task, _timeout);
+    };
+
+    bool steal(Task &task) {
+        for (auto victim : _victims) {
+            if (victim->TryPop(task)) {
+                return true;
             }
-        } else {
-            printf("[Warn] task timeout %u wait %ld ms\n", task._id, wait);
         }
-    };
+        return false;
+    }
+
+    // run the due timers, the clock is read only if there are some
+    size_t fire() {
+        if (_timers.Idle()) {
+            return 0;
+        }
+        auto now = std::chrono::steady_clock::now();
+        return _timers.Fire(now, [this, now](Task &task) {
+            // the delay is not waiting time
+            task._ts = now;
+            execute(task);
+        });
+    }
+
+    // how long a park may last: sleep ms, or less if a timer is due before
+    unsigned park() {
+        if (_timers.Idle()) {
+            return _sleep;
+        }
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(_timers.Wait(std::chrono::steady_clock::now()));
+        auto ms = (unsigned)std::max<int64_t>(1, std::min<int64_t>(wait.count(), UINT32_MAX));
+        return _sleep == 0 ? ms : std::min(_sleep, ms);
+    }
 
 protected:
     const unsigned _id;
@@ -184,9 +431,13 @@ protected:
     const unsigned _timeout;
 
     queue *const _local;
-    queue *const _steal;
+    std::vector<queue *> _victims;
+    int _cpu;
+    std::string _name;
 
-    mutable bool _running;
+    std::atomic<bool> _running;
+    Parker _parker;
+    TimerQueue<Task> _timers;
     std::thread _thread;
 };
 
@@ -201,6 +452,7 @@ public:
 
 public:
     virtual bool Init(unsigned pool_size, unsigned queue_len, unsigned sleep, unsigned timeout) {
+        _timeout = timeout;
         _queues.reserve(pool_size);
         for (unsigned idx = 0; idx < pool_size; ++idx) {
             std::unique_ptr<queue> q(new MPMCQueue<Task>(queue_len));
@@ -219,6 +471,7 @@ public:
             }
             _workers.push_back(std::move(worker));
         }
+        place();
         for (auto &worker : _workers) {
             if (!worker->Start()) {
                 return false;
@@ -235,27 +488,186 @@ public:
         }
     }
 
-    virtual bool Submit(unsigned uid, Task task) {
-        unsigned try_count = 0;
+    // task is moved from only if it was accepted
+    virtual bool Submit(unsigned uid, Task &&task) {
+        if (!_backpressure.Admit()) {
+            return false;
+        }
+        unsigned route_id = route(uid);
+        return enqueue(route_id, task) || overflow(route_id, task);
+    }
+
+    // spread tasks over the queues from one route, one claim per queue, what no queue takes goes through
+    // the backpressure policy one by one; tasks [0, n) are accepted and moved from, tasks [n, count) are
+    // rejected (throttled or full) and left untouched, return n
+    virtual size_t SubmitBulk(unsigned uid, Task *tasks, size_t count) {
+        auto admitted = _backpressure.Admit(count);
         unsigned route_id = route(uid);
-        while (try_count < _queues.size()) {
-            unsigned id = (route_id + try_count) % (unsigned)_queues.size();
-            if (_workers[id]->Add(std::move(task))) {
+        auto size = (unsigned)_queues.size();
+        size_t done = 0;
+        for (unsigned try_count = 0; try_count < size && done < admitted; ++try_count) {
+            unsigned id = (route_id + try_count) % size;
+            // what a full queue leaves spills over to the next ones
+            size_t share = (admitted - done + (size - try_count) - 1) / (size - try_count);
+            auto pushed = _workers[id]->AddBulk(tasks + done, share);
+            if (pushed > 0) {
+                done += pushed;
+                if (!_workers[id]->Unpark()) {
+                    _workers[(id + 1) % _workers.size()]->Unpark();
+                }
+            }
+        }
+        while (done < admitted) {
+            if (!overflow(route_id, tasks[done])) {
+                // the failed one is counted already
+                _backpressure.Reject(admitted - done - 1);
+                break;
+            }
+            ++done;
+        }
+        return done;
+    }
+
+    // run task once delay has passed, on the worker it is routed to (no queue hop, the delay does not count
+    // against timeout); false if the pool is not running
+    virtual bool SubmitAfter(std::chrono::milliseconds delay, unsigned uid, Task &&task) {
+        if (_workers.empty()) {
+            return false;
+        }
+        return _workers[route(uid)]->AddTimer(std::chrono::steady_clock::now() + delay,
+                                              std::chrono::milliseconds(0), std::move(task));
+    }
+
+    // run fn every period on one worker until token is cancelled or the pool stops; runs never overlap,
+    // a run longer than period delays the next one instead of queueing a burst
+    virtual bool SubmitEvery(std::chrono::milliseconds period, unsigned uid, Task::Func fn,
+                             CancelToken token = CancelToken()) {
+        if (period.count() <= 0) {
+            printf("[Warn] invalid period %ld ms\n", (long)period.count());
+            return false;
+        }
+        if (_workers.empty()) {
+            return false;
+        }
+        auto now = std::chrono::steady_clock::now();
+        return _workers[route(uid)]->AddTimer(now + period, period, Task(uid, now, std::move(fn), std::move(token)));
+    }
+
+    // run one queued task on the calling thread, the own queue of a worker first; false if none
+    bool RunPending() {
+        auto size = (unsigned)_queues.size();
+        unsigned start = RouteRandom() % size;
+        auto worker = Worker<Task, queue>::Current();
+        for (unsigned idx = 0; idx < size; ++idx) {
+            if (_workers[idx].get() == worker) {
+                start = idx;
+                break;
+            }
+        }
+        for (unsigned offset = 0; offset < size; ++offset) {
+            Task task;
+            if (_queues[(start + offset) % size]->TryPop(task)) {
+                RunTask(task, _timeout);
                 return true;
             }
-            ++try_count;
         }
-        printf("[Warn] all the queues are full\n");
         return false;
     }
 
+    // number of workers
+    virtual unsigned Size() const {
+        return (unsigned)_workers.size();
+    }
+
+    // what Submit does when the queues are full, call it before submitting
+    void SetBackpressure(const BackpressureOptions &options) {
+        _backpressure.Reset(options);
+    }
+
+    // pin and name the workers, call it before Init()
+    void SetPlacement(const PlacementOptions &options) {
+        _placement = options;
+    }
+
+    BackpressureStats Rejections() const {
+        return _backpressure.Stats();
+    }
+
 protected:
+    // pinned: worker i on the i-th cpu of the placement order, it steals from the nearest workers first
+    // (ties in ring order, so the worker next to i still steals from i first)
+    void place() {
+        auto size = (unsigned)_workers.size();
+        std::vector<int> cpus(size, -1);
+        auto &topology = CpuTopology::Get();
+        if (_placement.pin) {
+            auto order = topology.PlacementOrder();
+            if (order.empty()) {
+                printf("[Warn] no cpu topology, workers are not pinned\n");
+            }
+            for (unsigned idx = 0; !order.empty() && idx < size; ++idx) {
+                cpus[idx] = order[idx % order.size()];
+            }
+        }
+        for (unsigned idx = 0; idx < size; ++idx) {
+            _workers[idx]->Place(cpus[idx], _placement.name);
+            if (cpus[idx] < 0 || size < 3) {
+                continue;
+            }
+            std::vector<unsigned> others;
+            for (unsigned offset = 1; offset < size; ++offset) {
+                others.push_back((idx + size - offset) % size);
+            }
+            std::stable_sort(others.begin(), others.end(), [&](unsigned lhs, unsigned rhs) {
+                return topology.Distance(cpus[idx], cpus[lhs]) < topology.Distance(cpus[idx], cpus[rhs]);
+            });
+            std::vector<queue *> victims;
+            for (auto other : others) {
+                victims.push_back(_queues[other].get());
+            }
+            _workers[idx]->SetVictims(std::move(victims));
+        }
+    }
+
+    // power of two choices: the shorter of two random queues, no state is shared between submitters
     inline unsigned route(unsigned) const {
-        static std::atomic<unsigned> round(0);
-        return round.fetch_add(1) % (unsigned)_queues.size();
+        auto size = (unsigned)_queues.size();
+        if (size == 1) {
+            return 0;
+        }
+        auto r = RouteRandom();
+        unsigned a = r % size;
+        unsigned b = (a + 1 + (r >> 16) % (size - 1)) % size;
+        return _queues[b]->Size() < _queues[a]->Size() ? b : a;
+    }
+
+    // try the routed queue then the others, task is moved from only if it was accepted
+    // every queue is full
+    bool overflow(unsigned route_id, Task &task) {
+        return _backpressure.Overflow([&]() { return enqueue(route_id, task); },
+                                      [&]() { return _workers[route_id]->DropOldest(); },
+                                      [&]() { RunTask(task, _timeout); });
+    }
+
+    bool enqueue(unsigned route_id, Task &task) {
+        auto size = (unsigned)_queues.size();
+        for (unsigned try_count = 0; try_count < size; ++try_count) {
+            unsigned id = (route_id + try_count) % size;
+            if (_workers[id]->Add(std::move(task))) {
+                // worker id + 1 steals from queue id
+                if (!_workers[id]->Unpark()) {
+                    _workers[(id + 1) % _workers.size()]->Unpark();
+                }
+                return true;
+            }
+        }
+        return false;
     }
 
 protected:
+    unsigned _timeout = 0;
+    Backpressure _backpressure;
+    PlacementOptions _placement;
     std::vector<std::unique_ptr<queue>> _queues;
     std::vector<std::unique_ptr<Worker<Task, queue>>> _workers;
 };
@@ -268,19 +680,23 @@ template <>
 class Worker<Task, MPSCQueue<Task>> {
 public:
     using queue = MPSCQueue<Task>;
+    using strand = Strand<Task>;
+    using ready_queue = MPMCQueue<strand *>;
 
 public:
-    Worker(unsigned id, unsigned sleep, unsigned timeout, queue *local)
+    Worker(unsigned id, unsigned sleep, unsigned timeout, ready_queue *ready)
         : _id(id)
         , _sleep(sleep)
         , _timeout(timeout)
-        , _local(local)
+        , _ready(ready)
+        , _cpu(-1)
         , _running(false) {
-        assert(local != nullptr);
+        assert(ready != nullptr);
     }
 
     virtual ~Worker() {
         _running = false;
+        _parker.Unpark();
         if (_thread.joinable()) {
             _thread.join();
         }
@@ -294,19 +710,20 @@ public:
         }
         _running = true;
         _thread = std::thread([this]() {
+            PlaceWorker(_id, _cpu, _name);
+            auto ready = [this]() { return !_running || _ready->Size() > 0 || _timers.Incoming(); };
+            unsigned idle = 0;
             while (_running) {
-                auto bulk = _local->TryPopBulk();
-                if (!bulk.empty()) {
-                    for (const auto &task : bulk) {
-                        execute(task);
-                    }
-                    continue;
+                if (fire() > 0) {
+                    idle = 0;
                 }
-                if (_sleep > 0) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(_sleep));
-                } else {
-                    std::this_thread::yield();
+                strand *s = nullptr;
+                if (_ready->TryPop(s)) {
+                    run(s);
+                    idle = 0;
+                    continue;
                 }
+                _parker.Idle(idle, ready, park());
             }
         });
 
@@ -319,58 +736,141 @@ public:
             return false;
         }
         _running = false;
+        _parker.Unpark();
         if (_thread.joinable()) {
             _thread.join();
         }
         if (clean) {
-            Task task;
-            while (_local->TryPop(task)) {
-                execute(task);
+            strand *s = nullptr;
+            while (_ready->TryPop(s)) {
+                run(s);
             }
         }
+        // timers are not tasks yet, they die with the run
+        _timers.Clear();
         return true;
     }
 
-    virtual bool Add(Task task) {
-        if (_local == nullptr) {
+    // s has just become runnable
+    virtual bool Add(strand *s) {
+        // never fails, the ready queue holds every strand
+        _ready->Push(s);
+        return true;
+    }
+
+    // run task on this worker at due, then every period if period is not zero, until it is cancelled
+    virtual bool AddTimer(Task::TimePoint due, std::chrono::milliseconds period, Task &&task) {
+        if (!_running) {
+            printf("[Warn] worker %u is not running\n", _id);
             return false;
         }
-        unsigned count = 0;
-        while (!_local->TryPush(std::move(task))) {
-            if (++count > 3) {
-                printf("[Warn] queue %u is full\n", _id);
-                return false;
+        _timers.Add(due, period, std::move(task));
+        _parker.Unpark();
+        return true;
+    }
+
+    // before Start(): cpu to pin the thread to (-1: float), thread name prefix (empty: keep)
+    void Place(int cpu, const std::string &name) {
+        _cpu = cpu;
+        _name = name;
+    }
+
+    // the calling thread is running a batch of s, maybe further up the stack (a task helping the pool)
+    static bool Holds(const strand *s) {
+        for (auto held = holding(); held != nullptr; held = held->outer) {
+            if (held->s == s) {
+                return true;
             }
-            std::this_thread::yield();
         }
+        return false;
+    }
+
+    // run a batch of one runnable strand on the calling thread, false if none
+    bool Help() {
+        strand *s = nullptr;
+        if (!_ready->TryPop(s)) {
+            return false;
+        }
+        run(s);
         return true;
     }
 
+    // wake the worker if it is parked, return false if it was not
+    bool Unpark() {
+        return _parker.Unpark();
+    }
+
 protected:
+    // the worker owns s until it hands it back or s runs dry
+    void run(strand *s) {
+        Held held{s, holding()};
+        holding() = &held;
+        auto count = std::min(s->Pending(), kBatch);
+        for (size_t idx = 0; idx < count; ++idx) {
+            Task task;
+            s->Pop(task);
+            execute(task);
+        }
+        holding() = held.outer;
+        if (s->Done(count)) {
+            _ready->Push(s);
+        }
+    }
+
     virtual void execute(const Task &task) {
+        RunTask(task, _timeout);
+    };
+
+    // run the due timers, the clock is read only if there are some
+    size_t fire() {
+        if (_timers.Idle()) {
+            return 0;
+        }
         auto now = std::chrono::steady_clock::now();
-        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(now - task._ts).count();
-        if (wait < _timeout) {
-            try {
-                task._func();
-            } catch (std::exception &e) {
-                printf("[Warn] task throw exception %s\n", e.what());
-            } catch (...) {
-                printf("[Warn] task throw non-std::exception\n");
-            }
-        } else {
-            printf("[Warn] task timeout %u wait %ld ms\n", task._id, wait);
+        return _timers.Fire(now, [this, now](Task &task) {
+            // the delay is not waiting time
+            task._ts = now;
+            execute(task);
+        });
+    }
+
+    // how long a park may last: sleep ms, or less if a timer is due before
+    unsigned park() {
+        if (_timers.Idle()) {
+            return _sleep;
         }
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(_timers.Wait(std::chrono::steady_clock::now()));
+        auto ms = (unsigned)std::max<int64_t>(1, std::min<int64_t>(wait.count(), UINT32_MAX));
+        return _sleep == 0 ? ms : std::min(_sleep, ms);
+    }
+
+protected:
+    // the strands whose batch the calling thread is inside of, innermost first
+    struct Held {
+        const strand *s;
+        Held *outer;
     };
 
+    static Held *&holding() {
+        static thread_local Held *held = nullptr;
+        return held;
+    }
+
 protected:
+    // tasks run before a busy strand goes back to the end of the ready queue
+    static constexpr size_t kBatch = 32;
+
     unsigned _id;
     unsigned _sleep;
     unsigned _timeout;
 
-    queue *_local;
+    ready_queue *_ready;
+    int _cpu;
+    std::string _name;
 
-    bool _running;
+    std::atomic<bool> _running;
+    Parker _parker;
+    TimerQueue<Task> _timers;
     std::thread _thread;
 };
 
@@ -378,30 +878,36 @@ template <>
 class Manager<Task, MPSCQueue<Task>> {
 public:
     using queue = MPSCQueue<Task>;
+    using strand = Worker<Task, queue>::strand;
+    using ready_queue = Worker<Task, queue>::ready_queue;
+
+    static constexpr unsigned kStrandsPerWorker = 64;
 
 public:
     Manager() = default;
     virtual ~Manager() = default;
 
 public:
+    // queue_len: max pending tasks of one strand
     virtual bool Init(unsigned pool_size, unsigned queue_len, unsigned sleep, unsigned timeout) {
-        _queues.reserve(pool_size);
-        for (unsigned idx = 0; idx < pool_size; ++idx) {
-            std::unique_ptr<queue> q(new MPSCQueue<Task>(queue_len));
-            if (q == nullptr) {
-                return false;
-            }
-            _queues.push_back(std::move(q));
+        _queue_len = queue_len;
+        _timeout = timeout;
+        _strands.reserve(pool_size * kStrandsPerWorker);
+        _coalescing.reserve(pool_size * kStrandsPerWorker);
+        for (unsigned idx = 0; idx < pool_size * kStrandsPerWorker; ++idx) {
+            _strands.emplace_back(new strand());
+            _coalescing.emplace_back(new Coalescing());
         }
+        _ready.reset(new ready_queue(_strands.size()));
         _workers.reserve(pool_size);
         for (unsigned idx = 0; idx < pool_size; ++idx) {
-            std::unique_ptr<Worker<Task, queue>> worker(
-                new Worker<Task, queue>(idx, sleep, timeout, _queues[idx].get()));
+            std::unique_ptr<Worker<Task, queue>> worker(new Worker<Task, queue>(idx, sleep, timeout, _ready.get()));
             if (worker == nullptr) {
                 return false;
             }
             _workers.push_back(std::move(worker));
         }
+        place();
         for (auto &worker : _workers) {
             if (!worker->Start()) {
                 return false;
@@ -416,20 +922,303 @@ public:
                 worker->Stop(clean);
             }
         }
+        // runners left in the strands (clean = false) will not run, a later submit must queue again
+        for (auto &index : _coalescing) {
+            std::lock_guard<SpinLockMutex> guard(index->mutex);
+            for (auto &entry : index->pending) {
+                entry.second->taken = true;
+            }
+            index->pending.clear();
+        }
     }
 
-    virtual bool Submit(unsigned uid, Task task) {
-        return _workers[route(uid)]->Add(std::move(task));
+    // task is moved from only if it was accepted
+    virtual bool Submit(unsigned uid, Task &&task) {
+        if (!_backpressure.Admit()) {
+            return false;
+        }
+        auto id = route(uid);
+        return enqueue(id, task) || overflow(id, task);
+    }
+
+    // tasks of one uid with one exchange, in order, what does not fit goes through the backpressure policy
+    // one by one; tasks [0, n) are accepted and moved from, tasks [n, count) are rejected (throttled or the
+    // strand is full) and left untouched, return n
+    virtual size_t SubmitBulk(unsigned uid, Task *tasks, size_t count) {
+        auto admitted = _backpressure.Admit(count);
+        auto id = route(uid);
+        auto s = _strands[id].get();
+        auto pending = s->Pending();
+        auto room = pending >= _queue_len ? 0 : _queue_len - pending;
+        auto done = std::min(admitted, room);
+        if (s->PushBulk(tasks, done)) {
+            schedule(id, s);
+        }
+        while (done < admitted) {
+            if (!overflow(id, tasks[done])) {
+                // the failed one is counted already
+                _backpressure.Reject(admitted - done - 1);
+                break;
+            }
+            ++done;
+        }
+        return done;
+    }
+
+    // queue task on the strand of uid once delay has passed, the timer lives on worker uid % pool_size;
+    // false if the pool is not running
+    virtual bool SubmitAfter(std::chrono::milliseconds delay, unsigned uid, Task &&task) {
+        if (_workers.empty()) {
+            return false;
+        }
+        auto token = task._token;
+        auto held = std::make_unique<Task>(std::move(task));
+        Task timer(uid, std::chrono::steady_clock::now(),
+                   [this, uid, held = std::move(held)]() {
+                       held->_ts = std::chrono::steady_clock::now();
+                       fire(uid, std::move(*held));
+                       return 0;
+                   },
+                   std::move(token));
+        return _workers[uid % _workers.size()]->AddTimer(std::chrono::steady_clock::now() + delay,
+                                                        std::chrono::milliseconds(0), std::move(timer));
+    }
+
+    // queue fn on the strand of uid every period until token is cancelled or the pool stops, so it keeps
+    // its place among the other tasks of uid
+    virtual bool SubmitEvery(std::chrono::milliseconds period, unsigned uid, Task::Func fn,
+                             CancelToken token = CancelToken()) {
+        if (period.count() <= 0) {
+            printf("[Warn] invalid period %ld ms\n", (long)period.count());
+            return false;
+        }
+        if (_workers.empty()) {
+            return false;
+        }
+        auto shared = std::make_shared<Task::Func>(std::move(fn));
+        auto now = std::chrono::steady_clock::now();
+        Task timer(uid, now,
+                   [this, uid, shared, token]() {
+                       auto func = [shared]() { return (*shared)(); };
+                       fire(uid, Task(uid, std::chrono::steady_clock::now(), std::move(func), token));
+                       return 0;
+                   },
+                   token);
+        return _workers[uid % _workers.size()]->AddTimer(now + period, period, std::move(timer));
+    }
+
+    // run a batch of one runnable strand on the calling thread, false if none; a task waiting here for
+    // tasks of its own strand never sees them run, it holds that strand (see Holds())
+    bool RunPending() {
+        return !_workers.empty() && _workers[0]->Help();
+    }
+
+    // the calling thread runs a task of the strand of uid: a task it submits to uid and then waits for
+    // would never run
+    bool Holds(unsigned uid) const {
+        return !_strands.empty() && Worker<Task, queue>::Holds(_strands[route(uid)].get());
+    }
+
+    // number of workers
+    virtual unsigned Size() const {
+        return (unsigned)_workers.size();
+    }
+
+    // what Submit does when the strand is full, call it before submitting
+    void SetBackpressure(const BackpressureOptions &options) {
+        _backpressure.Reset(options);
+    }
+
+    // pin and name the workers, call it before Init()
+    void SetPlacement(const PlacementOptions &options) {
+        _placement = options;
+    }
+
+    BackpressureStats Rejections() const {
+        return _backpressure.Stats();
+    }
+
+    // like Submit, but while a task of the same uid and key is still pending (not started) task replaces
+    // it instead of being queued again: a storm of refreshes runs once, with the latest task, at the place
+    // of the first one; task is moved from only if it was accepted or coalesced
+    virtual bool SubmitCoalesce(unsigned uid, uint64_t key, Task &&task) {
+        auto id = route(uid);
+        auto index = _coalescing[id].get();
+        {
+            std::lock_guard<SpinLockMutex> guard(index->mutex);
+            auto iter = index->pending.find(key);
+            if (iter != index->pending.end() && iter->second->task._id == uid) {
+                iter->second->task = std::move(task);
+                _coalesced.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        auto slot = std::make_shared<Pending>(std::move(task));
+        // the runner has no timeout of its own, the task it runs is checked when it comes up
+        Task runner(uid, std::chrono::steady_clock::now(), [claim = Claim(this, id, key, slot)]() mutable {
+            auto latest = claim.Take();
+            RunTask(latest, claim.manager->_timeout);
+            return 0;
+        });
+        if (!Submit(uid, std::move(runner))) {
+            // nobody else has seen slot
+            task = std::move(slot->task);
+            return false;
+        }
+        // indexed only once queued; two first submits racing here are both queued, never lost
+        std::lock_guard<SpinLockMutex> guard(index->mutex);
+        if (!slot->taken) {
+            index->pending[key] = std::move(slot);
+        }
+        return true;
+    }
+
+    // tasks replaced by SubmitCoalesce instead of being queued
+    uint64_t Coalesced() const {
+        return _coalesced.load(std::memory_order_relaxed);
     }
 
 protected:
+    // a coalescing task while it is pending, guarded by the index of its strand
+    struct Pending {
+        explicit Pending(Task &&t)
+            : task(std::move(t))
+            , taken(false) {}
+
+        Task task;
+        bool taken;
+    };
+
+    // pending coalescing tasks of one strand by key
+    struct Coalescing {
+        SpinLockMutex mutex;
+        std::unordered_map<uint64_t, std::shared_ptr<Pending>> pending;
+    };
+
+    // held by the runner of a slot: takes the slot out of the index when the runner runs or, run or not,
+    // when the pool drops it (timeout, Stop) so that the key never points at a task nobody will run
+    struct Claim {
+        Claim(Manager *m, unsigned i, uint64_t k, std::shared_ptr<Pending> p)
+            : manager(m)
+            , id(i)
+            , key(k)
+            , slot(std::move(p)) {}
+
+        Claim(Claim &&other) noexcept = default;
+        Claim &operator=(Claim &&) = delete;
+
+        ~Claim() {
+            if (slot != nullptr) {
+                manager->retire(id, key, slot);
+            }
+        }
+
+        Task Take() {
+            return manager->retire(id, key, slot);
+        }
+
+        Manager *manager;
+        unsigned id;
+        uint64_t key;
+        std::shared_ptr<Pending> slot;
+    };
+
+    // slot will not be run again: unindex it and hand its task over
+    Task retire(unsigned id, uint64_t key, const std::shared_ptr<Pending> &slot) {
+        auto index = _coalescing[id].get();
+        std::lock_guard<SpinLockMutex> guard(index->mutex);
+        slot->taken = true;
+        auto iter = index->pending.find(key);
+        if (iter != index->pending.end() && iter->second == slot) {
+            index->pending.erase(iter);
+        }
+        return std::move(slot->task);
+    }
+
+    // pinned: worker i on the i-th cpu of the placement order (the ready queue is shared, no victims)
+    void place() {
+        auto order = _placement.pin ? CpuTopology::Get().PlacementOrder() : std::vector<int>();
+        if (_placement.pin && order.empty()) {
+            printf("[Warn] no cpu topology, workers are not pinned\n");
+        }
+        for (unsigned idx = 0; idx < _workers.size(); ++idx) {
+            _workers[idx]->Place(order.empty() ? -1 : order[idx % order.size()], _placement.name);
+        }
+    }
+
     inline unsigned route(unsigned uid) const {
-        return uid % (unsigned)_queues.size();
+        return uid % (unsigned)_strands.size();
+    }
+
+    // task is moved from only if it was accepted
+    // the strand is full; only the owner may pop a strand, there is no oldest task to drop
+    bool overflow(unsigned id, Task &task) {
+        return _backpressure.Overflow([&]() { return enqueue(id, task); }, []() { return false; },
+                                      [&]() { RunTask(task, _timeout); });
+    }
+
+    bool enqueue(unsigned id, Task &task) {
+        auto s = _strands[id].get();
+        if (s->Pending() >= _queue_len) {
+            return false;
+        }
+        if (s->Push(std::move(task))) {
+            schedule(id, s);
+        }
+        return true;
+    }
+
+    // a timer of uid is due, it skips admission: the task was accepted when the timer was
+    void fire(unsigned uid, Task &&task) {
+        if (!enqueue(route(uid), task)) {
+            printf("[Warn] strand %u is full, timer task %u dropped\n", route(uid), uid);
+        }
+    }
+
+    // s has just become runnable
+    void schedule(unsigned id, strand *s) {
+        _workers[id % _workers.size()]->Add(s);
+        // the ready queue is shared, any parked worker will do
+        for (auto &worker : _workers) {
+            if (worker->Unpark()) {
+                break;
+            }
+        }
     }
 
 protected:
-    std::vector<std::unique_ptr<queue>> _queues;
+    unsigned _queue_len = 0;
+    unsigned _timeout = 0;
+    Backpressure _backpressure;
+    PlacementOptions _placement;
+    // before _strands: runners left in the strands unindex themselves when they are destroyed
+    std::vector<std::unique_ptr<Coalescing>> _coalescing;
+    std::vector<std::unique_ptr<strand>> _strands;
+    std::atomic<uint64_t> _coalesced{0};
+    std::unique_ptr<ready_queue> _ready;
     std::vector<std::unique_ptr<Worker<Task, queue>>> _workers;
 };
 
+// a Manager behind the Executor interface (eg: the callbacks of a TimeWheel on the pool), tasks go to uid
+template <typename QUEUE>
+class ManagerExecutor : public Executor {
+public:
+    explicit ManagerExecutor(Manager<Task, QUEUE> &manager, unsigned uid = 0)
+        : _manager(manager)
+        , _uid(uid) {}
+
+public:
+    bool Execute(Callback cb) override {
+        return _manager.Submit(_uid, Task(_uid, std::chrono::steady_clock::now(), std::move(cb)));
+    }
+
+    unsigned Concurrency() const override {
+        return _manager.Size();
+    }
+
+private:
+    Manager<Task, QUEUE> &_manager;
+    const unsigned _uid;
+};
+
 } // namespace scorpion
@@ -0,0 +1,195 @@
+/**
+ * What a Manager does with a task it cannot queue right away.
+ *
+ * Key Features:
+ * 0. kDropNewest (default): Submit returns false, the task is given back to nobody.
+ * 1. kBlock: Submit retries with a growing backoff for at most block_ms, then gives up.
+ * 2. kCallerRuns: the submitting thread runs the task itself, which slows the producer down.
+ * 3. kDropOldest: the oldest task of the target queue is discarded to make room (pools whose queues
+ *    can only be popped by their owner fall back to kDropNewest).
+ * 4. Optional admission through a TokenBucket (rate tasks/s, burst tasks) before the task is queued,
+ *    tasks above the rate are shed whatever the policy is.
+ * 5. Every outcome but a plain accept is counted, Stats() returns a snapshot.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "SpinLockMutex.h"
+#include "TokenBucket.h"
+
+namespace scorpion {
+
+enum class RejectPolicy : unsigned { kDropNewest = 0, kBlock = 1, kCallerRuns = 2, kDropOldest = 3 };
+
+struct BackpressureOptions {
+    RejectPolicy policy = RejectPolicy::kDropNewest;
+    unsigned block_ms = 10; // kBlock: longest a submitter waits for room
+    int64_t rate = 0;       // admission: tasks per second, 0 to admit everything
+    int64_t burst = 0;      // admission: bucket size, 0 for rate
+};
+
+struct BackpressureStats {
+    uint64_t blocked;        // submits which had to wait for room
+    uint64_t block_timeouts; // ... and gave up
+    uint64_t caller_runs;    // tasks run by the submitting thread
+    uint64_t dropped_oldest; // queued tasks discarded for a newer one
+    uint64_t dropped_newest; // submits rejected
+    uint64_t throttled;      // submits shed by the token bucket
+};
+
+class Backpressure {
+public:
+    Backpressure() {
+        Reset(BackpressureOptions());
+    }
+
+    Backpressure(const Backpressure &) = delete;
+    Backpressure &operator=(const Backpressure &) = delete;
+
+public:
+    // not thread safe, call it before tasks are submitted
+    void Reset(const BackpressureOptions &options) {
+        _options = options;
+        _bucket.reset();
+        if (options.rate > 0) {
+            _bucket.reset(new TokenBucket(options.burst > 0 ? options.burst : options.rate, options.rate));
+        }
+        for (auto &counter : _counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    const BackpressureOptions &Options() const {
+        return _options;
+    }
+
+    // false if the task must be shed before it is queued
+    bool Admit() {
+        if (_bucket == nullptr) {
+            return true;
+        }
+        bool granted = false;
+        {
+            std::lock_guard<SpinLockMutex> guard(_mutex);
+            granted = _bucket->grant();
+        }
+        if (!granted) {
+            count(kThrottled);
+        }
+        return granted;
+    }
+
+    // a batch: how many of the first tasks may be queued, the rest is shed
+    size_t Admit(size_t tasks) {
+        if (_bucket == nullptr) {
+            return tasks;
+        }
+        size_t granted = 0;
+        {
+            std::lock_guard<SpinLockMutex> guard(_mutex);
+            while (granted < tasks && _bucket->grant()) {
+                ++granted;
+            }
+        }
+        count(kThrottled, tasks - granted);
+        return granted;
+    }
+
+    // the rest of a batch given up after a failed Overflow()
+    void Reject(size_t tasks) {
+        count(kDroppedNewest, tasks);
+    }
+
+    // the first push failed: push() retries, drop() discards the oldest queued task (false if it cannot),
+    // run() executes the task on this thread; return what Submit returns
+    template <typename Push, typename Drop, typename Run>
+    bool Overflow(const Push &push, const Drop &drop, const Run &run) {
+        switch (_options.policy) {
+        case RejectPolicy::kBlock: {
+            count(kBlocked);
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_options.block_ms);
+            for (unsigned round = 0;; ++round) {
+                if (push()) {
+                    return true;
+                }
+                if (std::chrono::steady_clock::now() >= deadline) {
+                    count(kBlockTimeouts);
+                    return false;
+                }
+                backoff(round);
+            }
+        }
+        case RejectPolicy::kCallerRuns:
+            count(kCallerRuns);
+            run();
+            return true;
+        case RejectPolicy::kDropOldest:
+            for (unsigned round = 0; round < kDropRounds && drop(); ++round) {
+                count(kDroppedOldest);
+                if (push()) {
+                    return true;
+                }
+            }
+            count(kDroppedNewest);
+            return false;
+        default:
+            count(kDroppedNewest);
+            return false;
+        }
+    }
+
+    BackpressureStats Stats() const {
+        BackpressureStats stats{};
+        stats.blocked = _counters[kBlocked].load(std::memory_order_relaxed);
+        stats.block_timeouts = _counters[kBlockTimeouts].load(std::memory_order_relaxed);
+        stats.caller_runs = _counters[kCallerRuns].load(std::memory_order_relaxed);
+        stats.dropped_oldest = _counters[kDroppedOldest].load(std::memory_order_relaxed);
+        stats.dropped_newest = _counters[kDroppedNewest].load(std::memory_order_relaxed);
+        stats.throttled = _counters[kThrottled].load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    enum Counter : unsigned {
+        kBlocked = 0,
+        kBlockTimeouts,
+        kCallerRuns,
+        kDroppedOldest,
+        kDroppedNewest,
+        kThrottled,
+        kCounters,
+    };
+
+    void count(Counter counter, uint64_t n = 1) {
+        if (n > 0) {
+            _counters[counter].fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    static void backoff(unsigned round) {
+        if (round < 16) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(round < 64 ? 50 : 200));
+        }
+    }
+
+private:
+    static constexpr unsigned kDropRounds = 4;
+
+    BackpressureOptions _options;
+    SpinLockMutex _mutex;
+    std::unique_ptr<TokenBucket> _bucket;
+    std::atomic<uint64_t> _counters[kCounters];
+};
+
+} // namespace scorpion
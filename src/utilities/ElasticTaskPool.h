@@ -0,0 +1,301 @@
+/**
+ * elastic version: the number of workers follows the load between min_workers and max_workers.
+ *
+ * Key Features:
+ * 0. Timeout task will be ignored.
+ * 1. There are always max_workers queues and a task goes to queue uid % max_workers, so resizing never
+ *    moves a task; with MPSCQueue tasks of the same queue are executed in order as in Manager.
+ * 2. The n active workers share the queues by stride (worker i serves i, i + n, ...). A worker claims a
+ *    queue before draining it, so a queue never has two consumers even while n is changing.
+ * 3. A controller thread adds a worker when a task waited longer than grow_wait_ms or a queue holds more
+ *    than grow_depth tasks (at most one per cooldown_ms), and retires one after the pool stayed idle for
+ *    idle_ms (one per idle_ms), never below min_workers or above max_workers.
+ * 4. An idle worker spins, yields, then parks (at most sleep ms, 0: until woken); a submit wakes the worker
+ *    serving its queue, a resize wakes them all to pick up the new stride.
+ * 5. Call Final(clean = true) to make sure no task is left behind (destructor will not do that).
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "AsyncTaskPool.h"
+#include "Parker.h"
+
+namespace scorpion {
+
+struct ElasticOptions {
+    unsigned min_workers = 1;
+    unsigned max_workers = 8; // also the number of queues
+    unsigned queue_len = 1024;
+    unsigned sleep = 1;          // ms an idle worker parks at most, 0 until woken
+    unsigned timeout = 1000;     // ms a task may wait before it is ignored
+    unsigned grow_wait_ms = 5;   // grow when a task waited longer than this
+    unsigned grow_depth = 64;    // or when a queue holds more tasks than this
+    unsigned cooldown_ms = 10;   // at least this long between two grows
+    unsigned idle_ms = 1000;     // shrink after the pool stayed idle this long
+    unsigned interval_ms = 1;    // controller period
+    unsigned batch = 32;         // tasks drained from a claimed queue at once
+};
+
+template <typename QUEUE>
+class ElasticManager {
+public:
+    using queue = QUEUE;
+
+public:
+    ElasticManager()
+        : _active(0)
+        , _running(false)
+        , _grows(0)
+        , _shrinks(0) {}
+
+    virtual ~ElasticManager() {
+        stop();
+    }
+
+    ElasticManager(const ElasticManager &) = delete;
+    ElasticManager &operator=(const ElasticManager &) = delete;
+
+public:
+    virtual bool Init(const ElasticOptions &options) {
+        if (_running) {
+            printf("[Warn] elastic manager is running\n");
+            return false;
+        }
+        if (options.max_workers == 0 || options.min_workers > options.max_workers) {
+            printf("[Warn] invalid workers range [%u, %u]\n", options.min_workers, options.max_workers);
+            return false;
+        }
+        _options = options;
+        _options.min_workers = std::max(1u, _options.min_workers);
+        _options.batch = std::max(1u, _options.batch);
+        _queues.clear();
+        _slots.clear();
+        for (unsigned idx = 0; idx < _options.max_workers; ++idx) {
+            _queues.emplace_back(new Queue(_options.queue_len));
+            _slots.emplace_back(new Slot());
+        }
+        _running = true;
+        for (unsigned idx = 0; idx < _options.min_workers; ++idx) {
+            startWorker(idx);
+        }
+        _active.store(_options.min_workers, std::memory_order_release);
+        _controller = std::thread([this]() { control(); });
+        return true;
+    }
+
+    virtual void Final(bool clean) {
+        stop();
+        if (clean) {
+            // every thread is joined, queue order is kept
+            for (auto &q : _queues) {
+                Task task;
+                while (q->tasks.TryPop(task)) {
+                    execute(task);
+                }
+            }
+        }
+    }
+
+    // task is moved from only if it was accepted
+    virtual bool Submit(unsigned uid, Task &&task) {
+        auto id = uid % (unsigned)_queues.size();
+        auto &q = *_queues[id];
+        unsigned count = 0;
+        while (!q.tasks.TryPush(std::move(task))) {
+            if (++count > 3) {
+                printf("[Warn] queue %u is full\n", id);
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        // read the stride after the push: a resize racing with it wakes every worker anyway
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto stride = std::max(1u, _active.load(std::memory_order_relaxed));
+        _slots[id % stride]->parker.Unpark();
+        return true;
+    }
+
+    // number of active workers
+    virtual unsigned Size() const {
+        return _active.load(std::memory_order_acquire);
+    }
+
+    uint64_t Grows() const {
+        return _grows.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Shrinks() const {
+        return _shrinks.load(std::memory_order_relaxed);
+    }
+
+protected:
+    struct alignas(128) Queue {
+        explicit Queue(size_t capacity)
+            : tasks(capacity)
+            , claimed(false) {}
+
+        QUEUE tasks;
+        std::atomic<bool> claimed;
+    };
+
+    struct alignas(128) Slot {
+        Slot()
+            : stop(false)
+            , max_wait_us(0) {}
+
+        std::thread thread;
+        std::atomic<bool> stop;
+        std::atomic<int64_t> max_wait_us; // longest wait seen since the controller looked
+        Parker parker;
+    };
+
+    void startWorker(unsigned id) {
+        auto &slot = *_slots[id];
+        slot.stop.store(false, std::memory_order_relaxed);
+        slot.thread = std::thread([this, id]() { work(id); });
+    }
+
+    void stopWorker(unsigned id) {
+        auto &slot = *_slots[id];
+        slot.stop.store(true, std::memory_order_release);
+        slot.parker.Unpark();
+        if (slot.thread.joinable()) {
+            slot.thread.join();
+        }
+    }
+
+    void stop() {
+        if (!_running.exchange(false)) {
+            return;
+        }
+        if (_controller.joinable()) {
+            _controller.join();
+        }
+        for (unsigned idx = 0; idx < _slots.size(); ++idx) {
+            stopWorker(idx);
+        }
+    }
+
+    void work(unsigned id) {
+        auto &slot = *_slots[id];
+        auto ready = [this, id, &slot]() {
+            if (slot.stop.load(std::memory_order_acquire)) {
+                return true;
+            }
+            auto stride = std::max(1u, _active.load(std::memory_order_acquire));
+            for (auto idx = id; idx < _queues.size(); idx += stride) {
+                if (_queues[idx]->tasks.Size() > 0) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        unsigned idle = 0;
+        while (!slot.stop.load(std::memory_order_acquire)) {
+            auto stride = std::max(1u, _active.load(std::memory_order_acquire));
+            size_t count = 0;
+            for (auto idx = id; idx < _queues.size(); idx += stride) {
+                count += drain(*_queues[idx], slot);
+            }
+            if (count > 0) {
+                idle = 0;
+                continue;
+            }
+            slot.parker.Idle(idle, ready, _options.sleep);
+        }
+    }
+
+    // the queues change hands, every worker looks again
+    void wakeAll() {
+        for (unsigned idx = 0; idx < _active.load(std::memory_order_relaxed); ++idx) {
+            _slots[idx]->parker.Unpark();
+        }
+    }
+
+    size_t drain(Queue &q, Slot &slot) {
+        if (q.claimed.load(std::memory_order_relaxed) || q.claimed.exchange(true, std::memory_order_acquire)) {
+            return 0;
+        }
+        size_t count = 0;
+        Task task;
+        int64_t max_wait = 0;
+        while (count < _options.batch && q.tasks.TryPop(task)) {
+            auto wait = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                              task._ts)
+                            .count();
+            max_wait = std::max(max_wait, (int64_t)wait);
+            execute(task);
+            ++count;
+        }
+        q.claimed.store(false, std::memory_order_release);
+        if (max_wait > slot.max_wait_us.load(std::memory_order_relaxed)) {
+            slot.max_wait_us.store(max_wait, std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    void control() {
+        auto now = std::chrono::steady_clock::now();
+        auto last_grow = now;
+        auto last_busy = now;
+        while (_running.load(std::memory_order_acquire)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(_options.interval_ms));
+            now = std::chrono::steady_clock::now();
+            int64_t max_wait = 0;
+            for (auto &slot : _slots) {
+                max_wait = std::max(max_wait, slot->max_wait_us.exchange(0, std::memory_order_relaxed));
+            }
+            size_t depth = 0;
+            for (auto &q : _queues) {
+                depth = std::max(depth, q->tasks.Size());
+            }
+            if (max_wait > 0 || depth > 0) {
+                last_busy = now;
+            }
+            auto active = _active.load(std::memory_order_relaxed);
+            bool overloaded = max_wait > (int64_t)_options.grow_wait_ms * 1000 || depth > _options.grow_depth;
+            if (overloaded && active < _options.max_workers &&
+                now - last_grow >= std::chrono::milliseconds(_options.cooldown_ms)) {
+                startWorker(active);
+                _active.store(active + 1, std::memory_order_release);
+                wakeAll();
+                _grows.fetch_add(1, std::memory_order_relaxed);
+                last_grow = now;
+            } else if (!overloaded && active > _options.min_workers &&
+                       now - last_busy >= std::chrono::milliseconds(_options.idle_ms)) {
+                // shrink the stride first, the retiring worker may still finish its batch
+                _active.store(active - 1, std::memory_order_release);
+                wakeAll();
+                stopWorker(active - 1);
+                _shrinks.fetch_add(1, std::memory_order_relaxed);
+                last_busy = now;
+            }
+        }
+    }
+
+    void execute(const Task &task) {
+        RunTask(task, _options.timeout);
+    }
+
+protected:
+    ElasticOptions _options;
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::unique_ptr<Slot>> _slots;
+    std::atomic<unsigned> _active;
+    std::atomic<bool> _running;
+    std::thread _controller;
+    std::atomic<uint64_t> _grows;
+    std::atomic<uint64_t> _shrinks;
+};
+
+} // namespace scorpion
@@ -0,0 +1,495 @@
+/**
+ * A staged pipeline: typed stages connected by SPSCQueue rings.
+ *
+ * Key Features:
+ * 0. Source<T>() creates the entry ring, Then<Out>() appends a Stage<In, Out>, Sink() ends a chain.
+ * 1. Every ring has exactly one producer and one consumer, a port can only be consumed once; Start()
+ *    fails while the output of a Then() stage is consumed by no stage (it would fill up and stall).
+ * 2. A stage runs on its own thread (dedicated) or on the pipeline's shared executor threads,
+ *    a stage never runs on two threads at the same time.
+ * 3. A stage moves up to "batch" elements per run; when its output ring is full the element is
+ *    parked and the stage stalls, so a slow stage fills the rings up to the source (backpressure).
+ * 4. Stop() closes the sources and returns after every stage drained its input, a stopped pipeline
+ *    can not start again.
+ * 5. Stats() reports per-stage processed/dropped/stall counters, throughput and ring occupancy.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "SPSCQueue.h"
+
+namespace scorpion {
+
+struct StageOptions {
+    size_t capacity = 1024; // capacity of the output ring (Then), at least 255: a smaller one is raised
+    size_t batch = 64;      // elements moved per run
+    bool dedicated = true;  // own thread or shared executor
+};
+
+struct StageStats {
+    std::string name;
+    uint64_t processed; // elements consumed from the input ring
+    uint64_t dropped;   // elements filtered out or failed
+    uint64_t stalls;    // times the output ring was full
+    size_t queued;      // current occupancy of the input ring
+    size_t capacity;    // capacity of the input ring (as raised by SPSCQueue)
+    double throughput;  // processed per second since Start()
+};
+
+class StageBase {
+public:
+    StageBase(std::string name, const StageOptions &options, const std::atomic<bool> *upstream)
+        : _name(std::move(name))
+        , _batch(options.batch == 0 ? 1 : options.batch)
+        , _dedicated(options.dedicated)
+        , _upstream(upstream)
+        , _done(false)
+        , _busy(false)
+        , _processed(0)
+        , _dropped(0)
+        , _stalls(0) {}
+
+    virtual ~StageBase() = default;
+
+    StageBase(const StageBase &) = delete;
+    StageBase &operator=(const StageBase &) = delete;
+
+public:
+    // run at most one batch, return the number of consumed elements
+    virtual size_t RunOnce() = 0;
+    virtual StageStats Stats() const = 0;
+
+    bool Finished() const {
+        return _done.load(std::memory_order_acquire);
+    }
+
+    bool Dedicated() const {
+        return _dedicated;
+    }
+
+    const std::atomic<bool> *Done() const {
+        return &_done;
+    }
+
+    // guarantee a single consumer when the stage runs on the shared executor
+    bool TryAcquire() {
+        return !_busy.exchange(true, std::memory_order_acquire);
+    }
+
+    void Release() {
+        _busy.store(false, std::memory_order_release);
+    }
+
+protected:
+    // done once a run found nothing to do after the upstream (read before the ring) was done
+    void checkDone(bool done) {
+        if (done) {
+            _done.store(true, std::memory_order_release);
+        }
+    }
+
+    void account(size_t processed, size_t dropped) {
+        if (processed > 0) {
+            _processed.fetch_add(processed, std::memory_order_relaxed);
+        }
+        if (dropped > 0) {
+            _dropped.fetch_add(dropped, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename F>
+    bool invoke(F &&f) {
+        try {
+            return f();
+        } catch (std::exception &e) {
+            printf("[Warn] stage %s throw exception %s\n", _name.c_str(), e.what());
+        } catch (...) {
+            printf("[Warn] stage %s throw non-std::exception\n", _name.c_str());
+        }
+        return false;
+    }
+
+    StageStats stats(size_t queued, size_t capacity) const {
+        return StageStats{_name,
+                          _processed.load(std::memory_order_relaxed),
+                          _dropped.load(std::memory_order_relaxed),
+                          _stalls.load(std::memory_order_relaxed),
+                          queued,
+                          capacity,
+                          0.0};
+    }
+
+protected:
+    const std::string _name;
+    const size_t _batch;
+    const bool _dedicated;
+    const std::atomic<bool> *const _upstream;
+
+    std::atomic<bool> _done;
+    std::atomic<bool> _busy;
+    std::atomic<uint64_t> _processed;
+    std::atomic<uint64_t> _dropped;
+    std::atomic<uint64_t> _stalls;
+};
+
+template <typename In, typename Out>
+class Stage : public StageBase {
+public:
+    // return false to drop the element
+    using Func = std::function<bool(In &, Out &)>;
+
+public:
+    Stage(std::string name, Func func, const StageOptions &options, SPSCQueue<In> *input,
+          const std::atomic<bool> *upstream, SPSCQueue<Out> *output)
+        : StageBase(std::move(name), options, upstream)
+        , _func(std::move(func))
+        , _input(input)
+        , _output(output) {}
+
+public:
+    size_t RunOnce() override {
+        if (_pending.has_value()) {
+            if (!_output->TryPush(std::move(*_pending))) {
+                _stalls.fetch_add(1, std::memory_order_relaxed);
+                return 0;
+            }
+            _pending.reset();
+        }
+        bool upstream = _upstream->load(std::memory_order_acquire);
+        size_t count = 0;
+        size_t dropped = 0;
+        In *item = nullptr;
+        while (count < _batch && (item = _input->Front()) != nullptr) {
+            Out out{};
+            bool keep = invoke([&]() { return _func(*item, out); });
+            _input->Pop();
+            ++count;
+            if (!keep) {
+                ++dropped;
+                continue;
+            }
+            if (!_output->TryPush(std::move(out))) {
+                _pending.emplace(std::move(out));
+                _stalls.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+        }
+        account(count, dropped);
+        checkDone(count == 0 && upstream && !_pending.has_value());
+        return count;
+    }
+
+    StageStats Stats() const override {
+        return stats(_input->Size(), _input->Capacity());
+    }
+
+private:
+    Func _func;
+    SPSCQueue<In> *const _input;
+    SPSCQueue<Out> *const _output;
+    std::optional<Out> _pending;
+};
+
+template <typename In>
+class Stage<In, void> : public StageBase {
+public:
+    using Func = std::function<void(In &)>;
+
+public:
+    Stage(std::string name, Func func, const StageOptions &options, SPSCQueue<In> *input,
+          const std::atomic<bool> *upstream)
+        : StageBase(std::move(name), options, upstream)
+        , _func(std::move(func))
+        , _input(input) {}
+
+public:
+    size_t RunOnce() override {
+        bool upstream = _upstream->load(std::memory_order_acquire);
+        size_t count = 0;
+        size_t dropped = 0;
+        In *item = nullptr;
+        while (count < _batch && (item = _input->Front()) != nullptr) {
+            bool ok = invoke([&]() {
+                _func(*item);
+                return true;
+            });
+            _input->Pop();
+            ++count;
+            dropped += ok ? 0 : 1;
+        }
+        account(count, dropped);
+        checkDone(count == 0 && upstream);
+        return count;
+    }
+
+    StageStats Stats() const override {
+        return stats(_input->Size(), _input->Capacity());
+    }
+
+private:
+    Func _func;
+    SPSCQueue<In> *const _input;
+};
+
+class Pipeline;
+
+// the producing end of a ring, only a source port may be pushed by the user (from one thread)
+template <typename T>
+class Port {
+public:
+    Port()
+        : _queue(nullptr)
+        , _done(nullptr) {}
+
+public:
+    template <typename P>
+    bool TryPush(P &&v) {
+        return _queue != nullptr && _queue->TryPush(std::forward<P>(v));
+    }
+
+    bool Valid() const {
+        return _queue != nullptr;
+    }
+
+private:
+    friend class Pipeline;
+
+    Port(SPSCQueue<T> *queue, const std::atomic<bool> *done)
+        : _queue(queue)
+        , _done(done) {}
+
+private:
+    SPSCQueue<T> *_queue;
+    const std::atomic<bool> *_done;
+};
+
+class Pipeline {
+public:
+    // threads shared by the stages created with dedicated = false
+    explicit Pipeline(unsigned executor_threads = 1)
+        : _executors(executor_threads)
+        , _running(false)
+        , _stopped(false)
+        , _broken(false) {}
+
+    ~Pipeline() {
+        Stop();
+    }
+
+    Pipeline(const Pipeline &) = delete;
+    Pipeline &operator=(const Pipeline &) = delete;
+
+public:
+    // capacity: at least 255 like StageOptions::capacity
+    template <typename T>
+    Port<T> Source(size_t capacity = StageOptions().capacity) {
+        auto queue = std::make_shared<SPSCQueue<T>>(capacity + 1);
+        _sources.emplace_back(new std::atomic<bool>(false));
+        _queues.push_back(queue);
+        return Port<T>(queue.get(), _sources.back().get());
+    }
+
+    template <typename Out, typename In, typename F>
+    Port<Out> Then(std::string name, Port<In> input, F &&func, const StageOptions &options = StageOptions()) {
+        if (!claim(name, input)) {
+            return Port<Out>();
+        }
+        auto output = std::make_shared<SPSCQueue<Out>>(options.capacity + 1);
+        _produced.emplace_back(output.get(), name);
+        std::unique_ptr<Stage<In, Out>> stage(new Stage<In, Out>(
+            std::move(name), std::forward<F>(func), options, input._queue, input._done, output.get()));
+        Port<Out> port(output.get(), stage->Done());
+        _queues.push_back(output);
+        _stages.push_back(std::move(stage));
+        return port;
+    }
+
+    template <typename In, typename F>
+    bool Sink(std::string name, Port<In> input, F &&func, const StageOptions &options = StageOptions()) {
+        if (!claim(name, input)) {
+            return false;
+        }
+        _stages.emplace_back(
+            new Stage<In, void>(std::move(name), std::forward<F>(func), options, input._queue, input._done));
+        return true;
+    }
+
+    bool Start() {
+        if (_running) {
+            printf("[Warn] pipeline is running\n");
+            return false;
+        }
+        if (_stopped) {
+            printf("[Warn] pipeline is stopped, its sources are closed\n");
+            return false;
+        }
+        if (_broken) {
+            printf("[Warn] pipeline is broken\n");
+            return false;
+        }
+        for (const auto &output : _produced) {
+            if (std::find(_consumed.begin(), _consumed.end(), output.first) == _consumed.end()) {
+                printf("[Warn] output of stage %s is not consumed\n", output.second.c_str());
+                return false;
+            }
+        }
+        if (_executors == 0) {
+            for (auto &stage : _stages) {
+                if (!stage->Dedicated()) {
+                    printf("[Warn] stage %s is shared but the pipeline has no executor thread\n",
+                           stage->Stats().name.c_str());
+                    return false;
+                }
+            }
+        }
+        _running = true;
+        _start = std::chrono::steady_clock::now();
+        bool shared = false;
+        for (auto &stage : _stages) {
+            if (stage->Dedicated()) {
+                auto ptr = stage.get();
+                _threads.emplace_back([ptr]() {
+                    unsigned idle = 0;
+                    while (!ptr->Finished()) {
+                        backoff(ptr->RunOnce() > 0, idle);
+                    }
+                });
+            } else {
+                shared = true;
+            }
+        }
+        for (unsigned idx = 0; shared && idx < _executors; ++idx) {
+            _threads.emplace_back([this]() { executor(); });
+        }
+        return true;
+    }
+
+    // close the sources and wait until every stage drained its input
+    void Stop() {
+        if (!_running) {
+            return;
+        }
+        for (auto &source : _sources) {
+            source->store(true, std::memory_order_release);
+        }
+        for (auto &t : _threads) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+        _threads.clear();
+        _stop = std::chrono::steady_clock::now();
+        _running = false;
+        _stopped = true;
+    }
+
+    std::vector<StageStats> Stats() const {
+        auto end = _running ? std::chrono::steady_clock::now() : _stop;
+        auto seconds = std::chrono::duration<double>(end - _start).count();
+        std::vector<StageStats> stats;
+        stats.reserve(_stages.size());
+        for (const auto &stage : _stages) {
+            stats.push_back(stage->Stats());
+            if (seconds > 0) {
+                stats.back().throughput = (double)stats.back().processed / seconds;
+            }
+        }
+        return stats;
+    }
+
+    void Dump() const {
+        for (const auto &s : Stats()) {
+            printf("[stage %s] processed %lu dropped %lu stalls %lu queued %zu/%zu throughput %.0f/s\n",
+                   s.name.c_str(), s.processed, s.dropped, s.stalls, s.queued, s.capacity, s.throughput);
+        }
+    }
+
+private:
+    template <typename T>
+    bool claim(const std::string &name, const Port<T> &input) {
+        if (_running) {
+            printf("[Warn] pipeline is running, can not add stage %s\n", name.c_str());
+            return false;
+        }
+        if (!input.Valid()) {
+            // the stage producing the input was rejected, the chain can not work
+            printf("[Warn] stage %s has an invalid input\n", name.c_str());
+            _broken = true;
+            return false;
+        }
+        for (auto consumed : _consumed) {
+            if (consumed == input._queue) {
+                printf("[Warn] input of stage %s is already consumed\n", name.c_str());
+                return false;
+            }
+        }
+        _consumed.push_back(input._queue);
+        return true;
+    }
+
+    static void backoff(bool busy, unsigned &idle) {
+        if (busy) {
+            idle = 0;
+        } else if (++idle < kSpinRounds) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(kIdleSleepUs));
+        }
+    }
+
+    void executor() {
+        unsigned idle = 0;
+        while (true) {
+            bool alive = false;
+            size_t count = 0;
+            for (auto &stage : _stages) {
+                if (stage->Dedicated() || stage->Finished()) {
+                    continue;
+                }
+                alive = true;
+                if (stage->TryAcquire()) {
+                    count += stage->RunOnce();
+                    stage->Release();
+                }
+            }
+            if (!alive) {
+                return;
+            }
+            backoff(count > 0, idle);
+        }
+    }
+
+private:
+    static constexpr unsigned kSpinRounds = 64;
+    static constexpr unsigned kIdleSleepUs = 100;
+
+    const unsigned _executors;
+    bool _running;
+    bool _stopped;
+    bool _broken;
+    std::chrono::time_point<std::chrono::steady_clock> _start;
+    std::chrono::time_point<std::chrono::steady_clock> _stop;
+
+    std::vector<std::shared_ptr<void>> _queues;
+    std::vector<const void *> _consumed;
+    std::vector<std::pair<const void *, std::string>> _produced; // Then() outputs and their stage
+    std::vector<std::unique_ptr<std::atomic<bool>>> _sources;
+    std::vector<std::unique_ptr<StageBase>> _stages;
+    std::vector<std::thread> _threads;
+};
+
+} // namespace scorpion
@@ -0,0 +1,360 @@
+/**
+ * specialization version: Worker has one mpmc queue per priority lane, lanes are served by deficit round-robin.
+ *
+ * Key Features:
+ * 0. Timeout task will be ignored.
+ * 1. Priority is chosen at submit time, Submit(uid, task) uses TaskPriority::kNormal.
+ * 2. Every round a lane earns its weight in tasks (default 8/4/1 for high/normal/low), leftover credit
+ *    of an emptied lane is dropped; a backlog of high tasks slows low ones down but never starves them.
+ * 3. Submitted task goes to the worker whose lane of its priority is the shorter of two picked at random
+ *    (power of two choices), an idle worker steals from the previous worker's lanes, highest priority first.
+ * 4. Stats() reports the depth and the submitted/executed/rejected counters of every lane.
+ * 5. An idle worker spins, yields, then parks (at most sleep ms, 0: until woken); a submit wakes the worker it
+ *    routed to, or the one stealing from it.
+ * 6. Call Final(clean = true) to make sure no task is left behind (destructor will not do that).
+ *
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "AsyncTaskPool.h"
+#include "AsyncTaskPoolTemplate.h"
+#include "MPMCQueue.h"
+#include "Parker.h"
+
+namespace scorpion {
+
+enum class TaskPriority : unsigned { kHigh = 0, kNormal = 1, kLow = 2 };
+
+constexpr size_t kPriorityLanes = 3;
+
+using LaneWeights = std::array<unsigned, kPriorityLanes>;
+
+struct LaneStats {
+    size_t depth;       // tasks waiting now
+    uint64_t submitted; // accepted by Submit
+    uint64_t executed;  // run or dropped as timeout
+    uint64_t rejected;  // all the queues were full
+};
+
+// the queues of one worker, one per priority
+template <typename QUEUE>
+class PriorityLanes {
+public:
+    struct alignas(128) Lane {
+        explicit Lane(size_t capacity)
+            : tasks(capacity)
+            , submitted(0)
+            , rejected(0)
+            , executed(0) {}
+
+        QUEUE tasks;
+        std::atomic<uint64_t> submitted;
+        std::atomic<uint64_t> rejected;
+        alignas(128) std::atomic<uint64_t> executed; // written by the consumers only
+    };
+
+public:
+    explicit PriorityLanes(size_t capacity) {
+        for (auto &lane : _lanes) {
+            lane.reset(new Lane(capacity));
+        }
+    }
+
+    Lane &At(TaskPriority priority) {
+        return *_lanes[(size_t)priority];
+    }
+
+    Lane &At(size_t lane) {
+        return *_lanes[lane];
+    }
+
+    const Lane &At(size_t lane) const {
+        return *_lanes[lane];
+    }
+
+private:
+    std::array<std::unique_ptr<Lane>, kPriorityLanes> _lanes;
+};
+
+template <>
+class Worker<Task, PriorityLanes<MPMCQueue<Task>>> {
+public:
+    using queue = PriorityLanes<MPMCQueue<Task>>;
+
+public:
+    Worker(unsigned id, unsigned sleep, unsigned timeout, queue *local, queue *steal, const LaneWeights &weights)
+        : _id(id)
+        , _sleep(sleep)
+        , _timeout(timeout)
+        , _local(local)
+        , _steal(steal)
+        , _weights(weights)
+        , _deficit()
+        , _running(false) {
+        assert(local != nullptr);
+    }
+
+    virtual ~Worker() {
+        _running = false;
+        _parker.Unpark();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+public:
+    virtual bool Start() {
+        if (_running) {
+            printf("[Warn] worker %u is running\n", _id);
+            return false;
+        }
+        _running = true;
+        _thread = std::thread([this]() {
+            auto ready = [this]() { return !_running || pending(_local) || pending(_steal); };
+            unsigned idle = 0;
+            while (_running) {
+                if (runRound() > 0 || stealOne()) {
+                    idle = 0;
+                    continue;
+                }
+                _parker.Idle(idle, ready, _sleep);
+            }
+        });
+        return true;
+    }
+
+    virtual bool Stop(bool clean) {
+        if (!_running) {
+            printf("[Warn] worker %u is not running\n", _id);
+            return false;
+        }
+        _running = false;
+        _parker.Unpark();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+        if (clean) {
+            for (size_t idx = 0; idx < kPriorityLanes; ++idx) {
+                auto &lane = _local->At(idx);
+                Task task;
+                while (lane.tasks.TryPop(task)) {
+                    execute(task, lane);
+                }
+            }
+        }
+        return true;
+    }
+
+    // task is moved from only if it was accepted
+    virtual bool Add(Task &&task) {
+        return Add(std::move(task), TaskPriority::kNormal);
+    }
+
+    virtual bool Add(Task &&task, TaskPriority priority) {
+        auto &lane = _local->At(priority);
+        unsigned count = 0;
+        while (!lane.tasks.TryPush(std::move(task))) {
+            if (++count > 3) {
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        lane.submitted.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // true if the worker was parked
+    bool Unpark() {
+        return _parker.Unpark();
+    }
+
+protected:
+    static bool pending(const queue *lanes) {
+        if (lanes == nullptr) {
+            return false;
+        }
+        for (size_t idx = 0; idx < kPriorityLanes; ++idx) {
+            if (lanes->At(idx).tasks.Size() > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // one deficit round-robin round over the own lanes, return the number of tasks run
+    size_t runRound() {
+        size_t count = 0;
+        for (size_t idx = 0; idx < kPriorityLanes; ++idx) {
+            auto &lane = _local->At(idx);
+            _deficit[idx] += _weights[idx];
+            Task task;
+            while (_deficit[idx] > 0) {
+                if (!lane.tasks.TryPop(task)) {
+                    // an empty lane does not bank credit
+                    _deficit[idx] = 0;
+                    break;
+                }
+                execute(task, lane);
+                --_deficit[idx];
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    bool stealOne() {
+        if (_steal == nullptr) {
+            return false;
+        }
+        for (size_t idx = 0; idx < kPriorityLanes; ++idx) {
+            auto &lane = _steal->At(idx);
+            Task task;
+            if (lane.tasks.TryPop(task)) {
+                execute(task, lane);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    virtual void execute(const Task &task, queue::Lane &lane) {
+        RunTask(task, _timeout);
+        lane.executed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+protected:
+    const unsigned _id;
+    const unsigned _sleep;
+    const unsigned _timeout;
+
+    queue *const _local;
+    queue *const _steal;
+    const LaneWeights _weights;
+    std::array<unsigned, kPriorityLanes> _deficit;
+
+    std::atomic<bool> _running;
+    Parker _parker;
+    std::thread _thread;
+};
+
+template <>
+class Manager<Task, PriorityLanes<MPMCQueue<Task>>> {
+public:
+    using queue = PriorityLanes<MPMCQueue<Task>>;
+
+public:
+    Manager() = default;
+    virtual ~Manager() = default;
+
+public:
+    // queue_len: capacity of every lane
+    virtual bool Init(unsigned pool_size, unsigned queue_len, unsigned sleep, unsigned timeout) {
+        return Init(pool_size, queue_len, sleep, timeout, LaneWeights{8, 4, 1});
+    }
+
+    virtual bool Init(unsigned pool_size, unsigned queue_len, unsigned sleep, unsigned timeout,
+                      const LaneWeights &weights) {
+        for (auto weight : weights) {
+            if (weight == 0) {
+                printf("[Warn] lane weight must be positive\n");
+                return false;
+            }
+        }
+        _queues.reserve(pool_size);
+        for (unsigned idx = 0; idx < pool_size; ++idx) {
+            _queues.emplace_back(new queue(queue_len));
+        }
+        _workers.reserve(pool_size);
+        for (unsigned idx = 0; idx < pool_size; ++idx) {
+            auto steal = (idx + pool_size - 1) % pool_size;
+            std::unique_ptr<Worker<Task, queue>> worker(new Worker<Task, queue>(
+                idx, sleep, timeout, _queues[idx].get(), steal == idx ? nullptr : _queues[steal].get(), weights));
+            _workers.push_back(std::move(worker));
+        }
+        for (auto &worker : _workers) {
+            if (!worker->Start()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    virtual void Final(bool clean) {
+        for (auto &worker : _workers) {
+            if (worker != nullptr) {
+                worker->Stop(clean);
+            }
+        }
+    }
+
+    // task is moved from only if it was accepted
+    virtual bool Submit(unsigned uid, Task &&task) {
+        return Submit(uid, std::move(task), TaskPriority::kNormal);
+    }
+
+    virtual bool Submit(unsigned uid, Task &&task, TaskPriority priority) {
+        unsigned try_count = 0;
+        unsigned route_id = route(uid, priority);
+        while (try_count < _queues.size()) {
+            unsigned id = (route_id + try_count) % (unsigned)_queues.size();
+            if (_workers[id]->Add(std::move(task), priority)) {
+                // worker id + 1 steals from worker id
+                if (!_workers[id]->Unpark()) {
+                    _workers[(id + 1) % _workers.size()]->Unpark();
+                }
+                return true;
+            }
+            ++try_count;
+        }
+        _queues[route_id]->At(priority).rejected.fetch_add(1, std::memory_order_relaxed);
+        printf("[Warn] all the queues of priority %u are full\n", (unsigned)priority);
+        return false;
+    }
+
+    // number of workers
+    virtual unsigned Size() const {
+        return (unsigned)_workers.size();
+    }
+
+    std::array<LaneStats, kPriorityLanes> Stats() const {
+        std::array<LaneStats, kPriorityLanes> stats{};
+        for (auto &q : _queues) {
+            for (size_t idx = 0; idx < kPriorityLanes; ++idx) {
+                auto &lane = q->At(idx);
+                stats[idx].depth += lane.tasks.Size();
+                stats[idx].submitted += lane.submitted.load(std::memory_order_relaxed);
+                stats[idx].executed += lane.executed.load(std::memory_order_relaxed);
+                stats[idx].rejected += lane.rejected.load(std::memory_order_relaxed);
+            }
+        }
+        return stats;
+    }
+
+protected:
+    // power of two choices on the lane of the task, as the mpmc manager does
+    inline unsigned route(unsigned, TaskPriority priority) const {
+        auto size = (unsigned)_queues.size();
+        if (size == 1) {
+            return 0;
+        }
+        auto r = RouteRandom();
+        unsigned a = r % size;
+        unsigned b = (a + 1 + (r >> 16) % (size - 1)) % size;
+        return _queues[b]->At(priority).tasks.Size() < _queues[a]->At(priority).tasks.Size() ? b : a;
+    }
+
+protected:
+    std::vector<std::unique_ptr<queue>> _queues;
+    std::vector<std::unique_ptr<Worker<Task, queue>>> _workers;
+};
+
+} // namespace scorpion
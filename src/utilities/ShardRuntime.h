@@ -0,0 +1,498 @@
+/**
+ * A thread-per-core, shared-nothing runtime: every shard is one pinned thread which owns its data,
+ * shards talk to each other only through an N x N mesh of SPSCQueue mailboxes.
+ *
+ * Key Features:
+ * 0. SubmitTo(shard, fn) from a shard thread goes through the (caller, target) mailbox, every ring
+ *    has exactly one producer and one consumer; other threads share the target's MPSC inbox.
+ * 1. SubmitTo(shard, fn, reply) runs fn on the target and reply(result) back on the calling shard,
+ *    Call(shard, fn) returns a Future for threads outside the runtime.
+ * 2. A full mailbox never blocks or fails a shard: the task waits in the caller's local overflow
+ *    (keeping the order) and is flushed on the next loop; a full inbox rejects the task.
+ * 3. Every shard has its own timer heap and pollers (eg: an Epoller or an EventQueue), all of them
+ *    only run on and are only touched from that shard's thread.
+ * 4. An idle shard spins a few loops then parks on a futex until a task, a timer or (with pollers)
+ *    at most poll_us; a producer pays a futex wake only if the target is parked.
+ * 5. Stop() lets every shard drain what it has, tasks posted to a shard which already left are dropped.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+#include "Futex.h"
+#include "Future.h"
+#include "InplaceFunction.h"
+#include "MPSCQueue.h"
+#include "SPSCQueue.h"
+#include "ThreadAffinity.h"
+
+namespace scorpion {
+
+struct ShardOptions {
+    size_t mailbox = 256;   // capacity of each shard to shard ring
+    size_t inbox = 4096;    // capacity of the inbox shared by non-shard threads
+    size_t batch = 64;      // tasks taken from one ring per loop
+    unsigned spin = 128;    // idle loops before parking
+    unsigned poll_us = 500; // longest park of a shard which has pollers
+    bool pin = true;        // pin shard i to the i-th allowed cpu
+    std::string name = "shard";
+};
+
+class ShardRuntime;
+
+class Shard {
+public:
+    using Func = InplaceFunction<void()>;
+    using Poller = InplaceFunction<size_t()>; // return the amount of work done, 0 if idle
+
+public:
+    Shard(unsigned id, const ShardRuntime *runtime, unsigned shards, const ShardOptions &options)
+        : _id(id)
+        , _runtime(runtime)
+        , _inbox(options.inbox)
+        , _overflow(shards)
+        , _backlog(0)
+        , _timer_seq(0)
+        , _parked(0)
+        , _executed(0)
+        , _parks(0) {}
+
+    Shard(const Shard &) = delete;
+    Shard &operator=(const Shard &) = delete;
+
+public:
+    unsigned Id() const {
+        return _id;
+    }
+
+    // run fn after delay, then every interval if it is not zero; shard thread only
+    uint64_t AddTimer(std::chrono::milliseconds delay, Func fn,
+                      std::chrono::milliseconds interval = std::chrono::milliseconds::zero()) {
+        auto id = ++_timer_seq;
+        _timers.push_back(Timer{std::chrono::steady_clock::now() + delay, interval, id, std::move(fn)});
+        std::push_heap(_timers.begin(), _timers.end(), Timer::Later);
+        _live.insert(id);
+        return id;
+    }
+
+    // shard thread only, false if the timer fired (and does not repeat) or is unknown
+    bool CancelTimer(uint64_t id) {
+        return _live.erase(id) > 0;
+    }
+
+    // called on every loop of this shard; shard thread only
+    void AddPoller(Poller poller) {
+        _pollers.push_back(std::move(poller));
+    }
+
+    // tasks and timers run so far, readable from any thread
+    uint64_t Executed() const {
+        return _executed.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Parks() const {
+        return _parks.load(std::memory_order_relaxed);
+    }
+
+private:
+    friend class ShardRuntime;
+
+    struct Timer {
+        std::chrono::steady_clock::time_point deadline;
+        std::chrono::milliseconds interval;
+        uint64_t id;
+        Func fn;
+
+        static bool Later(const Timer &a, const Timer &b) {
+            return a.deadline > b.deadline;
+        }
+    };
+
+    void execute(const Func &fn) {
+        try {
+            fn();
+        } catch (std::exception &e) {
+            printf("[Warn] shard %u task throw exception %s\n", _id, e.what());
+        } catch (...) {
+            printf("[Warn] shard %u task throw non-std::exception\n", _id);
+        }
+        _executed.store(_executed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    size_t fireTimers() {
+        size_t count = 0;
+        auto now = std::chrono::steady_clock::now();
+        while (!_timers.empty() && _timers.front().deadline <= now) {
+            std::pop_heap(_timers.begin(), _timers.end(), Timer::Later);
+            auto timer = std::move(_timers.back());
+            _timers.pop_back();
+            if (_live.count(timer.id) == 0) {
+                continue;
+            }
+            execute(timer.fn);
+            ++count;
+            if (timer.interval.count() > 0 && _live.count(timer.id) != 0) {
+                timer.deadline = now + timer.interval;
+                _timers.push_back(std::move(timer));
+                std::push_heap(_timers.begin(), _timers.end(), Timer::Later);
+            } else {
+                _live.erase(timer.id);
+            }
+        }
+        return count;
+    }
+
+    size_t runPollers() {
+        size_t count = 0;
+        for (auto &poller : _pollers) {
+            count += poller();
+        }
+        return count;
+    }
+
+private:
+    const unsigned _id;
+    const ShardRuntime *const _runtime;
+
+    MPSCQueue<Func> _inbox;
+    std::vector<std::deque<Func>> _overflow; // per target, waiting for room in the mailbox
+    size_t _backlog;                         // total size of _overflow
+
+    std::vector<Timer> _timers; // min heap by deadline
+    std::unordered_set<uint64_t> _live;
+    uint64_t _timer_seq;
+    std::vector<Poller> _pollers;
+
+    std::thread _thread;
+
+    // written by the producers, on a line of its own
+    alignas(128) std::atomic<uint32_t> _parked;
+    alignas(128) std::atomic<uint64_t> _executed;
+    std::atomic<uint64_t> _parks;
+};
+
+class ShardRuntime {
+public:
+    using Func = Shard::Func;
+
+public:
+    // shards == 0: one shard per allowed cpu
+    explicit ShardRuntime(unsigned shards = 0, ShardOptions options = ShardOptions())
+        : _options(std::move(options))
+        , _size(shards > 0 ? shards : std::max(1u, (unsigned)AllowedCpus().size()))
+        , _running(false) {
+        _mesh.reserve((size_t)_size * _size);
+        for (size_t idx = 0; idx < (size_t)_size * _size; ++idx) {
+            _mesh.emplace_back(new SPSCQueue<Func>(_options.mailbox));
+        }
+        _shards.reserve(_size);
+        for (unsigned idx = 0; idx < _size; ++idx) {
+            _shards.emplace_back(new Shard(idx, this, _size, _options));
+        }
+    }
+
+    ~ShardRuntime() {
+        Stop();
+    }
+
+    ShardRuntime(const ShardRuntime &) = delete;
+    ShardRuntime &operator=(const ShardRuntime &) = delete;
+
+public:
+    bool Start() {
+        if (_running.exchange(true)) {
+            printf("[Warn] shard runtime is running\n");
+            return false;
+        }
+        for (auto &shard : _shards) {
+            auto ptr = shard.get();
+            ptr->_thread = std::thread([this, ptr]() { loop(*ptr); });
+        }
+        return true;
+    }
+
+    void Stop() {
+        if (!_running.exchange(false)) {
+            return;
+        }
+        for (auto &shard : _shards) {
+            wake(*shard);
+        }
+        for (auto &shard : _shards) {
+            if (shard->_thread.joinable()) {
+                shard->_thread.join();
+            }
+        }
+    }
+
+    unsigned Size() const {
+        return _size;
+    }
+
+    // the shard of this runtime running on the calling thread, if any
+    Shard *Current() const {
+        auto shard = current();
+        return shard != nullptr && shard->_runtime == this ? shard : nullptr;
+    }
+
+    Shard &At(unsigned shard) {
+        return *_shards[shard];
+    }
+
+    // fire and forget, false if shard is out of range or (from a non-shard thread) its inbox is full
+    template <typename F>
+    bool SubmitTo(unsigned shard, F &&f) {
+        if (shard >= _size) {
+            printf("[Warn] shard %u out of range %u\n", shard, _size);
+            return false;
+        }
+        return post(*_shards[shard], wrap(std::forward<F>(f)));
+    }
+
+    // run f on shard and reply(result) back on the calling shard, skipped if f throws
+    template <typename F, typename Reply>
+    bool SubmitTo(unsigned shard, F &&f, Reply &&reply) {
+        auto origin = Current();
+        if (origin == nullptr) {
+            printf("[Warn] reply needs a shard thread, use Call() instead\n");
+            return false;
+        }
+        auto from = origin->Id();
+        return SubmitTo(shard, [this, from, func = std::forward<F>(f), rep = std::forward<Reply>(reply)]() mutable {
+            using R = typename std::invoke_result<decltype(func) &>::type;
+            if constexpr (std::is_void<R>::value) {
+                func();
+                SubmitTo(from, std::move(rep));
+            } else {
+                SubmitTo(from, [rep = std::move(rep), result = func()]() mutable { rep(std::move(result)); });
+            }
+        });
+    }
+
+    // run f on shard from any thread, the future completes on the shard
+    template <typename F>
+    auto Call(unsigned shard, F &&f) -> Future<typename std::invoke_result<typename std::decay<F>::type &>::type> {
+        using R = typename std::invoke_result<typename std::decay<F>::type &>::type;
+        auto state = std::make_shared<detail::FutureState<R>>();
+        bool ok = SubmitTo(shard, [state, func = std::forward<F>(f)]() mutable { detail::Fulfil(*state, func); });
+        if (!ok) {
+            state->SetException(std::make_exception_ptr(std::runtime_error("shard rejected the task")));
+        }
+        return Future<R>(std::move(state));
+    }
+
+protected:
+    static Shard *&current() {
+        static thread_local Shard *shard = nullptr;
+        return shard;
+    }
+
+    template <typename F>
+    static Func wrap(F &&f) {
+        using D = typename std::decay<F>::type;
+        if constexpr (std::is_same<D, Func>::value) {
+            return std::forward<F>(f);
+        } else if constexpr (Func::Fits<D>() && std::is_nothrow_move_constructible<D>::value) {
+            return Func(std::forward<F>(f));
+        } else {
+            // too large to be stored inline, pay one allocation
+            return Func([ptr = std::make_unique<D>(std::forward<F>(f))]() { (*ptr)(); });
+        }
+    }
+
+    SPSCQueue<Func> &mailbox(unsigned from, unsigned to) {
+        return *_mesh[(size_t)from * _size + to];
+    }
+
+    bool post(Shard &target, Func fn) {
+        auto origin = Current();
+        if (origin != nullptr) {
+            auto &overflow = origin->_overflow[target._id];
+            if (!overflow.empty() || !mailbox(origin->_id, target._id).TryPush(std::move(fn))) {
+                overflow.push_back(std::move(fn));
+                ++origin->_backlog;
+                return true;
+            }
+            if (origin != &target) {
+                wake(target);
+            }
+            return true;
+        }
+        if (!target._inbox.TryPush(std::move(fn))) {
+            printf("[Warn] inbox of shard %u is full\n", target._id);
+            return false;
+        }
+        wake(target);
+        return true;
+    }
+
+    // pairs with the fence in park(): either the shard sees the task or we see it parked
+    static void wake(Shard &target) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (target._parked.load(std::memory_order_relaxed) != 0 && target._parked.exchange(0) != 0) {
+            FutexWake(&target._parked);
+        }
+    }
+
+    size_t flush(Shard &shard) {
+        if (shard._backlog == 0) {
+            return 0;
+        }
+        size_t count = 0;
+        for (unsigned to = 0; to < _size; ++to) {
+            auto &overflow = shard._overflow[to];
+            auto &ring = mailbox(shard._id, to);
+            size_t moved = 0;
+            while (!overflow.empty() && ring.TryPush(std::move(overflow.front()))) {
+                overflow.pop_front();
+                ++moved;
+            }
+            if (moved > 0 && to != shard._id) {
+                wake(*_shards[to]);
+            }
+            count += moved;
+        }
+        shard._backlog -= count;
+        return count;
+    }
+
+    size_t drain(Shard &shard) {
+        size_t count = 0;
+        for (unsigned from = 0; from < _size; ++from) {
+            auto &ring = mailbox(from, shard._id);
+            for (size_t n = 0; n < _options.batch; ++n) {
+                auto front = ring.Front();
+                if (front == nullptr) {
+                    break;
+                }
+                Func fn(std::move(*front));
+                ring.Pop();
+                shard.execute(fn);
+                ++count;
+            }
+        }
+        Func fn;
+        for (size_t n = 0; n < _options.batch && shard._inbox.TryPop(fn); ++n) {
+            shard.execute(fn);
+            fn = nullptr;
+            ++count;
+        }
+        return count;
+    }
+
+    bool pending(Shard &shard) {
+        for (unsigned from = 0; from < _size; ++from) {
+            if (mailbox(from, shard._id).Front() != nullptr) {
+                return true;
+            }
+        }
+        return !shard._inbox.Empty();
+    }
+
+    void park(Shard &shard) {
+        shard._parked.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (pending(shard) || !_running.load(std::memory_order_relaxed)) {
+            shard._parked.store(0, std::memory_order_relaxed);
+            return;
+        }
+        auto bounded = !shard._pollers.empty() || shard._backlog > 0;
+        auto timeout = std::chrono::nanoseconds(std::chrono::microseconds(_options.poll_us));
+        if (!shard._timers.empty()) {
+            auto left = shard._timers.front().deadline - std::chrono::steady_clock::now();
+            timeout = bounded ? std::min(timeout, left) : left;
+            bounded = true;
+        }
+        shard._parks.store(shard._parks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (bounded) {
+            FutexWaitFor(&shard._parked, 1, timeout);
+        } else {
+            FutexWait(&shard._parked, 1);
+        }
+        shard._parked.store(0, std::memory_order_relaxed);
+    }
+
+    void loop(Shard &shard) {
+        current() = &shard;
+        if (_options.pin && !PinThread(shard._id)) {
+            printf("[Warn] failed to pin shard %u\n", shard._id);
+        }
+        SetThreadName(_options.name + std::to_string(shard._id));
+
+        unsigned idle = 0;
+        while (true) {
+            auto count = flush(shard) + drain(shard) + shard.fireTimers() + shard.runPollers();
+            if (count > 0) {
+                idle = 0;
+                continue;
+            }
+            if (!_running.load(std::memory_order_acquire)) {
+                if (shard._backlog == 0 || idle++ > _options.spin) {
+                    break;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            if (++idle < _options.spin) {
+                std::this_thread::yield();
+                continue;
+            }
+            park(shard);
+            idle = 0;
+        }
+        current() = nullptr;
+    }
+
+private:
+    const ShardOptions _options;
+    const unsigned _size;
+    std::atomic<bool> _running;
+    std::vector<std::unique_ptr<SPSCQueue<Func>>> _mesh; // [from * size + to]
+    std::vector<std::unique_ptr<Shard>> _shards;
+};
+
+// one cache line padded T per shard, Get() returns the calling shard's own slot
+template <typename T>
+class ShardLocal {
+public:
+    explicit ShardLocal(const ShardRuntime &runtime)
+        : _runtime(runtime)
+        , _slots(runtime.Size()) {}
+
+public:
+    T &Get() {
+        auto shard = _runtime.Current();
+        assert(shard != nullptr);
+        return _slots[shard->Id()].value;
+    }
+
+    // another shard's slot, only safe while the runtime is stopped
+    T &At(unsigned shard) {
+        return _slots[shard].value;
+    }
+
+private:
+    struct alignas(128) Slot {
+        T value{};
+    };
+
+    const ShardRuntime &_runtime;
+    std::vector<Slot> _slots;
+};
+
+} // namespace scorpion
@@ -0,0 +1,303 @@
+/**
+ * specialization version: Worker owns a Chase-Lev deque, external tasks go through a global injection queue.
+ *
+ * Key Features:
+ * 0. Timeout task will be ignored.
+ * 1. work-stealing -> task is executed out of order.
+ * 2. Task submitted from outside the pool is pushed into the global injection queue (mpmc).
+ * 3. Task submitted from a worker (eg: a task spawning sub tasks) is pushed into the worker's own deque,
+ *    the owner pops it LIFO while the other workers steal FIFO from the top.
+ * 4. An idle worker tries its deque, then the injection queue, then every other worker starting at a random victim;
+ *    after that it spins, yields, then parks (at most sleep ms, 0: until woken), a submit wakes one parked worker.
+ * 5. Call Final(clean = true) to make sure no task is left behind (destructor will not do that).
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "AsyncTaskPool.h"
+#include "AsyncTaskPoolTemplate.h"
+#include "MPMCQueue.h"
+#include "Parker.h"
+#include "WorkStealingDeque.h"
+
+namespace scorpion {
+
+template <>
+class Worker<Task, WorkStealingDeque<Task *>> {
+public:
+    using queue = WorkStealingDeque<Task *>;
+
+public:
+    Worker(unsigned id, unsigned sleep, unsigned timeout, queue *local, MPMCQueue<Task> *inject,
+           const std::vector<std::unique_ptr<queue>> *victims, const void *owner)
+        : _id(id)
+        , _sleep(sleep)
+        , _timeout(timeout)
+        , _local(local)
+        , _inject(inject)
+        , _victims(victims)
+        , _owner(owner)
+        , _seed(id * 2654435761u + 1u)
+        , _running(false) {
+        assert(local != nullptr && inject != nullptr && victims != nullptr);
+    }
+
+    virtual ~Worker() {
+        _running = false;
+        _parker.Unpark();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+        clear();
+    }
+
+public:
+    virtual bool Start() {
+        if (_running) {
+            printf("[Warn] worker %u is running\n", _id);
+            return false;
+        }
+        _running = true;
+        _thread = std::thread([this]() {
+            current() = this;
+            auto ready = [this]() {
+                return !_running || _local->Size() > 0 || _inject->Size() > 0 ||
+                       std::any_of(_victims->begin(), _victims->end(),
+                                   [](const std::unique_ptr<queue> &q) { return q->Size() > 0; });
+            };
+            unsigned idle = 0;
+            while (_running) {
+                if (runOnce()) {
+                    idle = 0;
+                } else {
+                    _parker.Idle(idle, ready, _sleep);
+                }
+            }
+            current() = nullptr;
+        });
+        return true;
+    }
+
+    virtual bool Stop(bool clean) {
+        if (!_running) {
+            printf("[Warn] worker %u is not running\n", _id);
+            return false;
+        }
+        _running = false;
+        _parker.Unpark();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+        if (clean) {
+            // the threads are joined, sub tasks spawned here land in the deque of this worker
+            current() = this;
+            while (runOnce()) {
+            }
+            current() = nullptr;
+        }
+        return true;
+    }
+
+    // only called on the worker's own thread
+    virtual bool Add(Task &&task) {
+        _local->Push(new Task(std::move(task)));
+        return true;
+    }
+
+    // own deque, injection queue, then the others; false if nothing was run
+    bool Help() {
+        return runOnce();
+    }
+
+    // true if the worker was parked
+    bool Unpark() {
+        return _parker.Unpark();
+    }
+
+    // the worker of the manager "owner" running on this thread, if any
+    static Worker *Current(const void *owner) {
+        auto worker = current();
+        return worker != nullptr && worker->_owner == owner ? worker : nullptr;
+    }
+
+protected:
+    static Worker *&current() {
+        static thread_local Worker *worker = nullptr;
+        return worker;
+    }
+
+    bool runOnce() {
+        Task *ptr = nullptr;
+        if (_local->TryPop(ptr)) {
+            std::unique_ptr<Task> task(ptr);
+            execute(*task);
+            return true;
+        }
+        Task task;
+        if (_inject->TryPop(task)) {
+            execute(task);
+            return true;
+        }
+        auto size = (unsigned)_victims->size();
+        auto start = random() % size;
+        for (unsigned offset = 0; offset < size; ++offset) {
+            auto &victim = (*_victims)[(start + offset) % size];
+            if (victim.get() != _local && victim->TrySteal(ptr)) {
+                std::unique_ptr<Task> stolen(ptr);
+                execute(*stolen);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // xorshift, good enough to spread the victims
+    unsigned random() {
+        _seed ^= _seed << 13;
+        _seed ^= _seed >> 17;
+        _seed ^= _seed << 5;
+        return _seed;
+    }
+
+    void clear() {
+        Task *ptr = nullptr;
+        while (_local->TryPop(ptr)) {
+            delete ptr;
+        }
+    }
+
+    virtual void execute(const Task &task) {
+        RunTask(task, _timeout);
+    };
+
+protected:
+    const unsigned _id;
+    const unsigned _sleep;
+    const unsigned _timeout;
+
+    queue *const _local;
+    MPMCQueue<Task> *const _inject;
+    const std::vector<std::unique_ptr<queue>> *const _victims;
+    const void *const _owner;
+    unsigned _seed;
+
+    std::atomic<bool> _running;
+    Parker _parker;
+    std::thread _thread;
+};
+
+template <>
+class Manager<Task, WorkStealingDeque<Task *>> {
+public:
+    using queue = WorkStealingDeque<Task *>;
+
+public:
+    Manager() = default;
+    virtual ~Manager() = default;
+
+public:
+    // queue_len: initial capacity of each deque, the injection queue holds pool_size * queue_len tasks
+    virtual bool Init(unsigned pool_size, unsigned queue_len, unsigned sleep, unsigned timeout) {
+        _timeout = timeout;
+        _inject.reset(new MPMCQueue<Task>((size_t)pool_size * queue_len));
+        _queues.reserve(pool_size);
+        for (unsigned idx = 0; idx < pool_size; ++idx) {
+            _queues.emplace_back(new queue(queue_len));
+        }
+        _workers.reserve(pool_size);
+        for (unsigned idx = 0; idx < pool_size; ++idx) {
+            std::unique_ptr<Worker<Task, queue>> worker(
+                new Worker<Task, queue>(idx, sleep, timeout, _queues[idx].get(), _inject.get(), &_queues, this));
+            _workers.push_back(std::move(worker));
+        }
+        for (auto &worker : _workers) {
+            if (!worker->Start()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    virtual void Final(bool clean) {
+        for (auto &worker : _workers) {
+            if (worker != nullptr) {
+                worker->Stop(clean);
+            }
+        }
+    }
+
+    // task is moved from only if it was accepted
+    virtual bool Submit(unsigned, Task &&task) {
+        auto worker = Worker<Task, queue>::Current(this);
+        if (worker != nullptr) {
+            worker->Add(std::move(task));
+            // the owner is busy, a parked worker may steal it
+            wake();
+            return true;
+        }
+        unsigned count = 0;
+        while (!_inject->TryPush(std::move(task))) {
+            if (++count > 3) {
+                printf("[Warn] injection queue is full\n");
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        wake();
+        return true;
+    }
+
+    // run one queued task on the calling thread, a worker helps through its own deque first; false if none
+    bool RunPending() {
+        auto worker = Worker<Task, queue>::Current(this);
+        if (worker != nullptr) {
+            return worker->Help();
+        }
+        Task task;
+        if (_inject->TryPop(task)) {
+            RunTask(task, _timeout);
+            return true;
+        }
+        Task *ptr = nullptr;
+        for (auto &victim : _queues) {
+            if (victim->TrySteal(ptr)) {
+                std::unique_ptr<Task> stolen(ptr);
+                RunTask(*stolen, _timeout);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // number of workers
+    virtual unsigned Size() const {
+        return (unsigned)_workers.size();
+    }
+
+protected:
+    // any parked worker will do, the queues are shared
+    void wake() {
+        for (auto &worker : _workers) {
+            if (worker->Unpark()) {
+                break;
+            }
+        }
+    }
+
+protected:
+    unsigned _timeout = 0;
+    std::unique_ptr<MPMCQueue<Task>> _inject;
+    std::vector<std::unique_ptr<queue>> _queues;
+    std::vector<std::unique_ptr<Worker<Task, queue>>> _workers;
+};
+
+} // namespace scorpion
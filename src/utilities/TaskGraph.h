@@ -0,0 +1,324 @@
+/**
+ * A task dependency graph (DAG) executed on the task pools.
+ *
+ * Key Features:
+ * 0. Emplace() declares a node, Precede(a, b) makes b wait for a; WhenAll()/WhenAny() add a join node
+ *    which runs once all / the first of its dependencies finished.
+ * 1. Every node has an atomic dependency counter: the worker finishing a node decrements its successors,
+ *    runs one ready successor inline and submits the others from its own thread (the stealing pool puts
+ *    them into that worker's deque).
+ * 2. A built graph can run again and again: Run() only resets the counters, nothing is allocated.
+ * 3. A throwing node cancels the nodes which did not start yet, Wait() returns false and Error() holds
+ *    the first exception.
+ * 4. A graph runs once at a time and must outlive its run. A node dropped by the pool (timeout, cancelled,
+ *    kDropOldest, Final(false)) fails the run like a throwing node, the run still finishes.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "AsyncTaskPool.h"
+#include "Futex.h"
+#include "InplaceFunction.h"
+
+namespace scorpion {
+
+class TaskGraph {
+public:
+    using Func = InplaceFunction<void()>;
+    using NodeId = size_t;
+
+public:
+    TaskGraph()
+        : _dirty(true)
+        , _running(false)
+        , _remaining(0)
+        , _finished(1)
+        , _waking(0)
+        , _failed(false) {}
+
+    ~TaskGraph() {
+        Wait();
+    }
+
+    TaskGraph(const TaskGraph &) = delete;
+    TaskGraph &operator=(const TaskGraph &) = delete;
+
+public:
+    NodeId Emplace(Func fn, std::string name = std::string()) {
+        _nodes.push_back(Node{std::move(fn), std::move(name), false, 0, {}});
+        _dirty = true;
+        return _nodes.size() - 1;
+    }
+
+    // after runs once before has finished
+    bool Precede(NodeId before, NodeId after) {
+        if (before >= _nodes.size() || after >= _nodes.size() || before == after) {
+            printf("[Warn] invalid edge %zu -> %zu\n", before, after);
+            return false;
+        }
+        _nodes[before].successors.push_back(after);
+        ++_nodes[after].predecessors;
+        _dirty = true;
+        return true;
+    }
+
+    // a node (running fn, if any) after all of deps
+    NodeId WhenAll(const std::vector<NodeId> &deps, Func fn = Func(), std::string name = "when_all") {
+        return join(deps, false, std::move(fn), std::move(name));
+    }
+
+    // a node (running fn, if any) after the first of deps, the others still run
+    NodeId WhenAny(const std::vector<NodeId> &deps, Func fn = Func(), std::string name = "when_any") {
+        return join(deps, true, std::move(fn), std::move(name));
+    }
+
+    // submit the roots to pool and return at once, false if running, empty or cyclic
+    template <typename QUEUE>
+    bool Run(Manager<Task, QUEUE> &pool) {
+        if (_running.exchange(true)) {
+            printf("[Warn] task graph is running\n");
+            return false;
+        }
+        if (_nodes.empty() || (_dirty && !build())) {
+            _running.store(false);
+            return false;
+        }
+        for (size_t idx = 0; idx < _nodes.size(); ++idx) {
+            _pending[idx].store(initial(_nodes[idx]), std::memory_order_relaxed);
+        }
+        _error = nullptr;
+        _failed.store(false, std::memory_order_relaxed);
+        _remaining.store(_nodes.size(), std::memory_order_relaxed);
+        _finished.store(0, std::memory_order_release);
+        _submit = [&pool](NodeId id, Task task) { return pool.Submit((unsigned)id, std::move(task)); };
+        for (auto id : _roots) {
+            submit(id);
+        }
+        return true;
+    }
+
+    // block until the current run (if any) finished, false if a node threw
+    bool Wait() {
+        while (_finished.load(std::memory_order_acquire) == 0) {
+            FutexWait(&_finished, 0);
+        }
+        // the last node may still be inside FutexWakeAll(&_finished), the graph must outlive that call
+        while (_waking.load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+        return !_failed.load(std::memory_order_acquire);
+    }
+
+    // run and wait
+    template <typename QUEUE>
+    bool RunAndWait(Manager<Task, QUEUE> &pool) {
+        return Run(pool) && Wait();
+    }
+
+    std::exception_ptr Error() const {
+        return _error;
+    }
+
+    size_t Size() const {
+        return _nodes.size();
+    }
+
+    void Dump() const {
+        for (size_t idx = 0; idx < _nodes.size(); ++idx) {
+            printf("[node %zu %s]", idx, _nodes[idx].name.c_str());
+            for (auto next : _nodes[idx].successors) {
+                printf(" -> %zu", next);
+            }
+            printf("\n");
+        }
+    }
+
+private:
+    struct Node {
+        Func fn;
+        std::string name;
+        bool any;
+        uint32_t predecessors;
+        std::vector<NodeId> successors;
+    };
+
+    static uint32_t initial(const Node &node) {
+        return node.any && node.predecessors > 0 ? 1u : node.predecessors;
+    }
+
+    NodeId join(const std::vector<NodeId> &deps, bool any, Func fn, std::string name) {
+        auto id = Emplace(std::move(fn), std::move(name));
+        _nodes[id].any = any;
+        for (auto dep : deps) {
+            Precede(dep, id);
+        }
+        return id;
+    }
+
+    // find the roots and reject cycles (Kahn), (re)allocate the counters
+    bool build() {
+        std::vector<uint32_t> degree(_nodes.size());
+        _roots.clear();
+        for (size_t idx = 0; idx < _nodes.size(); ++idx) {
+            degree[idx] = _nodes[idx].predecessors;
+            if (degree[idx] == 0) {
+                _roots.push_back(idx);
+            }
+        }
+        std::vector<NodeId> ready(_roots);
+        size_t visited = 0;
+        while (!ready.empty()) {
+            auto id = ready.back();
+            ready.pop_back();
+            ++visited;
+            for (auto next : _nodes[id].successors) {
+                if (--degree[next] == 0) {
+                    ready.push_back(next);
+                }
+            }
+        }
+        if (visited != _nodes.size()) {
+            printf("[Warn] task graph has a cycle\n");
+            return false;
+        }
+        _pending.reset(new std::atomic<uint32_t>[_nodes.size()]);
+        _dirty = false;
+        return true;
+    }
+
+    // finishes the node when the pool is done with it, run or dropped
+    struct Dispatch {
+        Dispatch(TaskGraph *g, NodeId node)
+            : graph(g)
+            , id(node) {}
+
+        Dispatch(Dispatch &&other) noexcept
+            : graph(std::exchange(other.graph, nullptr))
+            , id(other.id) {}
+
+        Dispatch &operator=(Dispatch &&) = delete;
+
+        ~Dispatch() {
+            if (graph != nullptr) {
+                graph->drop(id);
+            }
+        }
+
+        void operator()() {
+            std::exchange(graph, nullptr)->execute(id);
+        }
+
+        TaskGraph *graph;
+        NodeId id;
+    };
+
+    void submit(NodeId id) {
+        Task task(0, std::chrono::steady_clock::now(), [dispatch = Dispatch(this, id)]() mutable {
+            dispatch();
+            return 0;
+        });
+        if (!_submit(id, std::move(task))) {
+            // the pool is full, run it here rather than losing it
+            task._func();
+        }
+    }
+
+    // the node never ran: fail the run, its successors are released (and skipped) as usual
+    void drop(NodeId id) {
+        fail(std::make_exception_ptr(std::runtime_error("task graph node dropped by the pool")));
+        execute(id);
+    }
+
+    // run id and then, inline, one of the successors it made ready
+    void execute(NodeId id) {
+        while (true) {
+            auto &node = _nodes[id];
+            if (node.fn && !_failed.load(std::memory_order_acquire)) {
+                try {
+                    node.fn();
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+            NodeId next = kNone;
+            for (auto succ : node.successors) {
+                if (!release(succ)) {
+                    continue;
+                }
+                if (next == kNone) {
+                    next = succ;
+                } else {
+                    submit(succ);
+                }
+            }
+            finish();
+            if (next == kNone) {
+                return;
+            }
+            id = next;
+        }
+    }
+
+    // true if succ became ready, only the first predecessor releases a when_any node
+    bool release(NodeId succ) {
+        auto &pending = _pending[succ];
+        if (_nodes[succ].any) {
+            uint32_t one = 1;
+            return pending.compare_exchange_strong(one, 0, std::memory_order_acq_rel);
+        }
+        return pending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    void fail(std::exception_ptr error) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_failed.load(std::memory_order_relaxed)) {
+            _error = std::move(error);
+            _failed.store(true, std::memory_order_release);
+        }
+    }
+
+    void finish() {
+        if (_remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        _waking.store(1, std::memory_order_relaxed);
+        _finished.store(1, std::memory_order_release);
+        FutexWakeAll(&_finished);
+        // a new Run() must not reset _finished before the wake above
+        _running.store(false, std::memory_order_release);
+        // last access to the graph, Wait() may return and the graph be destroyed right after
+        _waking.store(0, std::memory_order_release);
+    }
+
+private:
+    static constexpr NodeId kNone = static_cast<NodeId>(-1);
+
+    std::vector<Node> _nodes;
+    std::vector<NodeId> _roots;
+    std::unique_ptr<std::atomic<uint32_t>[]> _pending;
+    bool _dirty;
+
+    InplaceFunction<bool(NodeId, Task)> _submit;
+    std::atomic<bool> _running;
+    std::atomic<size_t> _remaining;
+    std::atomic<uint32_t> _finished;
+    std::atomic<uint32_t> _waking; // finish() is between publishing _finished and waking the waiters
+    std::atomic<bool> _failed;
+    std::exception_ptr _error;
+    std::mutex _mutex;
+};
+
+} // namespace scorpion
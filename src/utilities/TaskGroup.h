@@ -0,0 +1,190 @@
+/**
+ * Fork-join on the pools: TaskGroup::Spawn() forks a child, Wait() joins them all.
+ *
+ * Key Features:
+ * 0. Wait() never blocks a worker: until the children are done the waiting thread runs queued tasks of the
+ *    pool itself (RunPending), so nested groups (divide and conquer) cannot starve the pool of workers.
+ * 1. Works on a ThreadPool and on the MPMC, strand and work-stealing managers. On the strand manager
+ *    the uid of the children must be given, and a child whose strand is held by the spawning thread (the
+ *    waiter could never see it run) runs inline in Spawn().
+ * 2. A child the pool does not accept (full queue) runs inline in Spawn().
+ * 3. The first exception of a child is kept, Wait() returns false and Error() rethrows it; the other
+ *    children still run.
+ * 4. A child dropped by the pool (timeout, cancelled, kDropOldest) still counts down and fails the group.
+ * 5. The destructor waits, a group never outlives its children.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "AsyncTaskPool.h"
+#include "Parker.h"
+#include "ThreadPool.h"
+
+namespace scorpion {
+
+namespace detail {
+
+// moved from only if the pool accepted it
+inline bool GroupSubmit(ThreadPool &pool, unsigned, InplaceFunction<int()> &fn) {
+    return pool.TryPush(std::move(fn));
+}
+
+// false: run it inline, the strand of uid is held by the caller and would wait for the caller
+inline bool GroupSubmit(Manager<Task, MPSCQueue<Task>> &pool, unsigned uid, InplaceFunction<int()> &fn) {
+    if (pool.Holds(uid)) {
+        return false;
+    }
+    Task task(uid, std::chrono::steady_clock::now(), std::move(fn));
+    if (pool.Submit(uid, std::move(task))) {
+        return true;
+    }
+    fn = std::move(task._func);
+    return false;
+}
+
+template <typename QUEUE>
+bool GroupSubmit(Manager<Task, QUEUE> &pool, unsigned uid, InplaceFunction<int()> &fn) {
+    Task task(uid, std::chrono::steady_clock::now(), std::move(fn));
+    if (pool.Submit(uid, std::move(task))) {
+        return true;
+    }
+    fn = std::move(task._func);
+    return false;
+}
+
+template <typename Pool>
+struct IsStrandPool : std::is_same<Pool, Manager<Task, MPSCQueue<Task>>> {};
+
+} // namespace detail
+
+template <typename Pool>
+class TaskGroup {
+public:
+    // uid: where the children go on a manager
+    TaskGroup(Pool &pool, unsigned uid)
+        : _pool(pool)
+        , _uid(uid)
+        , _pending(0)
+        , _failed(false) {}
+
+    explicit TaskGroup(Pool &pool)
+        : TaskGroup(pool, 0) {
+        static_assert(!detail::IsStrandPool<Pool>::value,
+                      "give the uid of the children on the strand manager, 0 may be the strand of the waiter");
+    }
+
+    ~TaskGroup() {
+        Wait();
+    }
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+public:
+    template <typename F>
+    void Spawn(F &&f) {
+        _pending.fetch_add(1, std::memory_order_relaxed);
+        auto child = [done = Completion(this), fn = std::forward<F>(f)]() mutable -> int {
+            try {
+                fn();
+            } catch (...) {
+                done.group->fail(std::current_exception());
+            }
+            done.ran = true;
+            return 0;
+        };
+        InplaceFunction<int()> task;
+        if constexpr (InplaceFunction<int()>::Fits<decltype(child)>()) {
+            task = std::move(child);
+        } else {
+            task = [ptr = std::make_unique<decltype(child)>(std::move(child))]() { return (*ptr)(); };
+        }
+        if (!detail::GroupSubmit(_pool, _uid, task)) {
+            task();
+        }
+    }
+
+    // help the pool until every child finished, false if one threw
+    bool Wait() {
+        unsigned idle = 0;
+        while (_pending.load(std::memory_order_acquire) > 0) {
+            if (_pool.RunPending()) {
+                idle = 0;
+                continue;
+            }
+            // the rest is running on other threads
+            if (idle++ < Parker::kSpin) {
+                CpuRelax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        return !_failed.load(std::memory_order_acquire);
+    }
+
+    // after Wait(), rethrow the first exception of a child
+    void Error() const {
+        if (_failed.load(std::memory_order_acquire)) {
+            std::rethrow_exception(_error);
+        }
+    }
+
+private:
+    // counts the child down when the pool is done with it, run or dropped (timeout, cancel, drop policy)
+    struct Completion {
+        explicit Completion(TaskGroup *g)
+            : group(g)
+            , ran(false) {}
+
+        Completion(Completion &&other) noexcept
+            : group(std::exchange(other.group, nullptr))
+            , ran(other.ran) {}
+
+        Completion &operator=(Completion &&) = delete;
+
+        ~Completion() {
+            if (group != nullptr) {
+                group->finish(ran);
+            }
+        }
+
+        TaskGroup *group;
+        bool ran;
+    };
+
+    void finish(bool ran) {
+        if (!ran) {
+            fail(std::make_exception_ptr(std::runtime_error("task group child dropped by the pool")));
+        }
+        // the group may be gone right after this
+        _pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void fail(std::exception_ptr error) {
+        bool expected = false;
+        if (_claimed.compare_exchange_strong(expected, true)) {
+            _error = std::move(error);
+            _failed.store(true, std::memory_order_release);
+        }
+    }
+
+private:
+    Pool &_pool;
+    const unsigned _uid;
+    std::atomic<unsigned> _pending;
+    std::atomic<bool> _claimed{false};
+    std::atomic<bool> _failed;
+    std::exception_ptr _error;
+};
+
+} // namespace scorpion
@@ -0,0 +1,135 @@
+/**
+ * The timers of one pool worker: a min-heap owned by the worker, fed by any thread through a small inbox.
+ *
+ * Key Features:
+ * 0. Add() may be called from any thread, the item lands in the inbox (spin lock + vector swap) and is
+ *    moved into the heap the next time the owner looks.
+ * 1. Fire() is called by the owner between tasks, it runs every due item on the calling thread.
+ * 2. A periodic item is re-armed at due + period (missed periods are skipped, not run in a burst) until
+ *    its Cancelled() turns true.
+ * 3. Wait() tells the owner how long it may park before the next item is due.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "SpinLockMutex.h"
+
+namespace scorpion {
+
+template <typename T>
+class TimerQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+public:
+    TimerQueue()
+        : _incoming(false) {}
+
+    TimerQueue(const TimerQueue &) = delete;
+    TimerQueue &operator=(const TimerQueue &) = delete;
+
+public:
+    // any thread, period zero for a one-shot item
+    void Add(Clock::time_point due, Clock::duration period, T item) {
+        std::lock_guard<SpinLockMutex> guard(_mutex);
+        _inbox.push_back(Timer{due, period, std::move(item)});
+        _incoming.store(true, std::memory_order_release);
+    }
+
+    // any thread, something is waiting in the inbox
+    bool Incoming() const {
+        return _incoming.load(std::memory_order_acquire);
+    }
+
+    // owner, nothing armed and nothing incoming: no need to read the clock
+    bool Idle() const {
+        return _heap.empty() && !Incoming();
+    }
+
+    // owner, run(item) every due item, return how many ran
+    template <typename Run>
+    size_t Fire(Clock::time_point now, const Run &run) {
+        collect();
+        size_t count = 0;
+        while (!_heap.empty() && _heap.front().due <= now) {
+            std::pop_heap(_heap.begin(), _heap.end(), Later());
+            auto timer = std::move(_heap.back());
+            _heap.pop_back();
+            if (timer.item.Cancelled()) {
+                continue;
+            }
+            run(timer.item);
+            ++count;
+            if (timer.period > Clock::duration::zero()) {
+                timer.due += timer.period;
+                if (timer.due <= now) {
+                    timer.due = now + timer.period;
+                }
+                _heap.push_back(std::move(timer));
+                std::push_heap(_heap.begin(), _heap.end(), Later());
+            }
+        }
+        return count;
+    }
+
+    // owner, how long until the next item is due, Clock::duration::max() if none
+    Clock::duration Wait(Clock::time_point now) {
+        collect();
+        if (_heap.empty()) {
+            return Clock::duration::max();
+        }
+        return std::max(Clock::duration::zero(), _heap.front().due - now);
+    }
+
+    // owner, drop everything (pending items are not run)
+    void Clear() {
+        collect();
+        _heap.clear();
+    }
+
+private:
+    struct Timer {
+        Clock::time_point due;
+        Clock::duration period;
+        T item;
+    };
+
+    struct Later {
+        bool operator()(const Timer &lhs, const Timer &rhs) const {
+            return lhs.due > rhs.due;
+        }
+    };
+
+    void collect() {
+        if (!Incoming()) {
+            return;
+        }
+        {
+            std::lock_guard<SpinLockMutex> guard(_mutex);
+            _swap.swap(_inbox);
+            _incoming.store(false, std::memory_order_relaxed);
+        }
+        for (auto &timer : _swap) {
+            _heap.push_back(std::move(timer));
+            std::push_heap(_heap.begin(), _heap.end(), Later());
+        }
+        _swap.clear();
+    }
+
+private:
+    SpinLockMutex _mutex;
+    std::vector<Timer> _inbox; // guarded by _mutex
+    std::atomic<bool> _incoming;
+    std::vector<Timer> _swap;
+    std::vector<Timer> _heap;
+};
+
+} // namespace scorpion
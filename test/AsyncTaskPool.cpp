@@ -1,10 +1,22 @@
 #include "AsyncTaskPool.h"
 
+#include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <string>
 #include <thread>
 #include <vector>
 
+#include "ElasticTaskPool.h"
+#include "PriorityTaskPool.h"
+#include "StealingTaskPool.h"
+
 using namespace std;
 using namespace chrono;
 using namespace scorpion;
@@ -15,6 +27,7 @@ constexpr const unsigned kSleepMs = 10;
 constexpr const unsigned kTimeoutMs = 100;
 constexpr const size_t kProducerNum = 10;
 constexpr const size_t kTestCounter = 10240;
+constexpr const unsigned kFanout = 4096;
 
 template <typename Manager, typename Task, unsigned P, unsigned Q, unsigned S, unsigned T>
 class TestAsyncTaskPoolTemplate {
@@ -73,9 +86,706 @@ void TestMPSCManager() {
     printf("mpsc mgr done!\n");
 }
 
+void TestStealingManager() {
+    unique_ptr<Manager<Task, WorkStealingDeque<Task *>>> manager(new Manager<Task, WorkStealingDeque<Task *>>);
+    TestAsyncTaskPoolTemplate<Manager<Task, WorkStealingDeque<Task *>>, Task, kPoolSize, kQueueLength, kSleepMs,
+                              kTimeoutMs>::TestExample(kProducerNum, kTestCounter, manager.get());
+    this_thread::sleep_for(seconds(5));
+    printf("stealing mgr done!\n");
+}
+
+void TestStealingImbalance() {
+    using StealingManager = Manager<Task, WorkStealingDeque<Task *>>;
+    unique_ptr<StealingManager> manager(new StealingManager);
+    manager->Init(kPoolSize, kQueueLength, 1, kTimeoutMs);
+
+    // a single root task spawns every sub task into its own deque, the others have to steal
+    atomic<unsigned> done(0);
+    mutex mtx;
+    set<thread::id> threads;
+    auto mgr = manager.get();
+    manager->Submit(0, Task(0, steady_clock::now(), [&, mgr]() -> int {
+        for (unsigned id = 1; id <= kFanout; ++id) {
+            mgr->Submit(id, Task(id, steady_clock::now(), [&]() -> int {
+                this_thread::sleep_for(microseconds(100));
+                {
+                    lock_guard<mutex> lock(mtx);
+                    threads.insert(this_thread::get_id());
+                }
+                done.fetch_add(1);
+                return 0;
+            }));
+        }
+        return 0;
+    }));
+    while (done.load() < kFanout) {
+        this_thread::sleep_for(milliseconds(10));
+    }
+    manager->Final(true);
+    printf("stealing imbalance done: %u tasks on %zu threads\n", done.load(), threads.size());
+}
+
+void TestElastic() {
+    constexpr unsigned kKeys = 16;
+    constexpr unsigned kTasks = 4000;
+    ElasticOptions options;
+    options.min_workers = 1;
+    options.max_workers = 4;
+    options.grow_wait_ms = 2;
+    options.idle_ms = 100;
+    ElasticManager<MPSCQueue<Task>> manager;
+    manager.Init(options);
+
+    // a burst of slow tasks makes the pool grow, every key must still see its tasks in order
+    vector<unsigned> last(kKeys, 0);
+    atomic<unsigned> done(0);
+    atomic<unsigned> disorder(0);
+    for (unsigned id = 1; id <= kTasks; ++id) {
+        auto key = id % kKeys;
+        while (!manager.Submit(key, Task(id, steady_clock::now(), [&, key, id]() -> int {
+            this_thread::sleep_for(microseconds(50));
+            if (last[key] >= id) {
+                disorder.fetch_add(1);
+            }
+            last[key] = id;
+            done.fetch_add(1);
+            return 0;
+        }))) {
+            this_thread::sleep_for(milliseconds(1));
+        }
+    }
+    unsigned peak = 0;
+    while (done.load() < kTasks) {
+        peak = max(peak, manager.Size());
+        this_thread::sleep_for(milliseconds(1));
+    }
+    // idle for a while, the pool shrinks back step by step
+    while (manager.Size() > options.min_workers) {
+        this_thread::sleep_for(milliseconds(10));
+    }
+    manager.Final(true);
+    assert(disorder.load() == 0);
+    printf("elastic done: peak %u workers, %lu grows, %lu shrinks\n", peak, (unsigned long)manager.Grows(),
+           (unsigned long)manager.Shrinks());
+
+    // sleep 0: the workers park until a submit wakes them, a rejected task stays with the caller
+    options = ElasticOptions();
+    options.max_workers = 2;
+    options.queue_len = 256;
+    options.sleep = 0;
+    ElasticManager<MPMCQueue<Task>> parked;
+    parked.Init(options);
+    this_thread::sleep_for(milliseconds(20));
+    atomic<bool> release(false);
+    atomic<unsigned> ran(0);
+    auto begin = steady_clock::now();
+    assert(parked.Submit(0, Task(0, begin, [&]() {
+        ran.fetch_add(1);
+        while (!release.load()) {
+            this_thread::sleep_for(milliseconds(1));
+        }
+        return 0;
+    })));
+    while (ran.load() == 0) {
+        this_thread::yield();
+    }
+    auto latency = duration_cast<microseconds>(steady_clock::now() - begin).count();
+    unsigned queued = 0;
+    while (parked.Submit(1, Task(1, steady_clock::now(), [&ran]() { return (int)ran.fetch_add(1); }))) {
+        ++queued;
+    }
+    Task rejected(1, steady_clock::now(), []() { return 0; });
+    assert(!parked.Submit(1, std::move(rejected)) && (bool)rejected._func);
+    release = true;
+    while (ran.load() < queued + 1) {
+        this_thread::sleep_for(milliseconds(1));
+    }
+    parked.Final(true);
+    printf("elastic parking done: wake latency %ld us, %u queued before the queue was full\n", (long)latency,
+           queued);
+    assert(latency < 100 * 1000);
+}
+
+void TestStrand() {
+    Manager<Task, MPSCQueue<Task>> manager;
+    manager.Init(4, kQueueLength, 1, 10000);
+    constexpr unsigned kKeys = 64;
+    constexpr unsigned kPerKey = 64;
+    vector<unsigned> last(kKeys, 0);
+    atomic<unsigned> disorder(0);
+    atomic<unsigned> others(0);
+    atomic<unsigned> hot(0);
+    atomic<unsigned> others_before_hot(0);
+    // key 0 is slow, keys sharing its worker under uid % size must not wait for it
+    for (unsigned seq = 1; seq <= kPerKey; ++seq) {
+        for (unsigned key = 0; key < kKeys; ++key) {
+            manager.Submit(key, Task(key, steady_clock::now(), [&, key, seq]() {
+                               if (last[key] + 1 != seq) {
+                                   disorder.fetch_add(1);
+                               }
+                               last[key] = seq;
+                               if (key == 0) {
+                                   this_thread::sleep_for(milliseconds(1));
+                                   if (hot.fetch_add(1) + 1 == kPerKey) {
+                                       others_before_hot.store(others.load());
+                                   }
+                               } else {
+                                   others.fetch_add(1);
+                               }
+                               return 0;
+                           }));
+        }
+    }
+    while (hot.load() < kPerKey || others.load() < (kKeys - 1) * kPerKey) {
+        this_thread::sleep_for(milliseconds(1));
+    }
+    manager.Final(true);
+    assert(disorder.load() == 0);
+    assert(others_before_hot.load() == (kKeys - 1) * kPerKey);
+    printf("strand done: %u keys in order, the slow key held one worker only\n", kKeys);
+}
+
+void TestPriority() {
+    Manager<Task, PriorityLanes<MPMCQueue<Task>>> manager;
+    manager.Init(1, kQueueLength, 1, 10000);
+    atomic<bool> release(false);
+    // hold the only worker so the lanes fill up before anything runs
+    manager.Submit(0, Task(0, steady_clock::now(), [&release]() {
+        while (!release.load()) {
+            this_thread::sleep_for(milliseconds(1));
+        }
+        return 0;
+    }));
+    this_thread::sleep_for(milliseconds(10));
+    constexpr unsigned kLow = 512;
+    constexpr unsigned kHigh = 64;
+    atomic<unsigned> low_done(0);
+    atomic<unsigned> low_before_high(0);
+    atomic<unsigned> high_done(0);
+    for (unsigned i = 0; i < kLow; ++i) {
+        manager.Submit(i, Task(i, steady_clock::now(), [&low_done]() { return (int)low_done.fetch_add(1); }),
+                       TaskPriority::kLow);
+    }
+    for (unsigned i = 0; i < kHigh; ++i) {
+        manager.Submit(i, Task(i, steady_clock::now(), [&]() {
+                           if (high_done.fetch_add(1) + 1 == kHigh) {
+                               low_before_high.store(low_done.load());
+                           }
+                           return 0;
+                       }),
+                       TaskPriority::kHigh);
+    }
+    auto stats = manager.Stats();
+    assert(stats[(size_t)TaskPriority::kLow].depth == kLow);
+    assert(stats[(size_t)TaskPriority::kHigh].depth == kHigh);
+    // a full lane rejects, the task stays with the caller
+    for (unsigned i = 0; i < kQueueLength; ++i) {
+        assert(manager.Submit(i, Task(i, steady_clock::now(), []() { return 0; })));
+    }
+    Task rejected(7, steady_clock::now(), []() { return 0; });
+    assert(!manager.Submit(7, std::move(rejected)) && rejected._id == 7 && (bool)rejected._func);
+    release = true;
+    while (low_done.load() < kLow) {
+        this_thread::sleep_for(milliseconds(1));
+    }
+    manager.Final(true);
+    // the high lane jumps the low backlog, but the low lane still gets one slot per round
+    assert(high_done.load() == kHigh);
+    assert(low_before_high.load() > 0 && low_before_high.load() <= kHigh / 8 + 1);
+    stats = manager.Stats();
+    for (size_t idx = 0; idx < kPriorityLanes; ++idx) {
+        printf("lane %zu: depth %zu submitted %lu executed %lu rejected %lu\n", idx, stats[idx].depth,
+               (unsigned long)stats[idx].submitted, (unsigned long)stats[idx].executed,
+               (unsigned long)stats[idx].rejected);
+        assert(stats[idx].depth == 0 && stats[idx].submitted == stats[idx].executed);
+    }
+    printf("priority done: %u low tasks ran before the last of %u high tasks\n", low_before_high.load(), kHigh);
+}
+
+template <typename QUEUE>
+void TestParking(const char *name) {
+    Manager<Task, QUEUE> manager;
+    // sleep 0: an idle worker parks until a task arrives
+    manager.Init(4, kQueueLength, 0, 10000);
+    this_thread::sleep_for(milliseconds(50));
+    auto cpu = clock();
+    this_thread::sleep_for(milliseconds(200));
+    auto idle_cpu_ms = (clock() - cpu) * 1000 / CLOCKS_PER_SEC;
+    int64_t worst = 0;
+    for (unsigned i = 0; i < 32; ++i) {
+        atomic<int64_t> latency(-1);
+        auto begin = steady_clock::now();
+        manager.Submit(i, Task(i, begin, [&latency, begin]() {
+                           latency = duration_cast<microseconds>(steady_clock::now() - begin).count();
+                           return 0;
+                       }));
+        while (latency.load() < 0) {
+            this_thread::yield();
+        }
+        worst = max(worst, latency.load());
+        this_thread::sleep_for(milliseconds(5));
+    }
+    manager.Final(true);
+    printf("%s parking done: idle cpu %ld ms in 200 ms, worst wake latency %ld us\n", name, (long)idle_cpu_ms,
+           (long)worst);
+    assert(idle_cpu_ms < 50);
+    assert(worst < 100 * 1000);
+}
+
+void TestCancel() {
+    Manager<Task, MPMCQueue<Task>> manager;
+    manager.Init(1, kQueueLength, 1, 10000);
+    atomic<bool> release(false);
+    manager.Submit(0, Task(0, steady_clock::now(), [&release]() {
+        while (!release.load()) {
+            this_thread::sleep_for(milliseconds(1));
+        }
+        return 0;
+    }));
+    atomic<unsigned> ran(0);
+    CancelSource source;
+    for (unsigned i = 0; i < 100; ++i) {
+        manager.Submit(i, Task(i, steady_clock::now(), [&ran]() { return (int)ran.fetch_add(1); }, source.Token()));
+    }
+    auto soon = steady_clock::now() + milliseconds(1);
+    for (unsigned i = 0; i < 10; ++i) {
+        manager.Submit(i, Task(i, steady_clock::now(), [&ran]() { return (int)ran.fetch_add(1); }, CancelToken(),
+                               soon));
+    }
+    // the caller gives up, nothing is scanned, the tasks are dropped when they come up
+    source.Cancel();
+    this_thread::sleep_for(milliseconds(5));
+    atomic<int64_t> remaining(-1);
+    atomic<bool> cancelled_inside(false);
+    CancelSource self;
+    manager.Submit(0, Task(
+                          0, steady_clock::now(),
+                          [&]() {
+                              remaining = duration_cast<milliseconds>(TaskContext::Remaining()).count();
+                              assert(!TaskContext::Cancelled());
+                              self.Cancel();
+                              cancelled_inside = TaskContext::Cancelled();
+                              return 0;
+                          },
+                          self.Token(), steady_clock::now() + seconds(1)));
+    release = true;
+    while (remaining.load() < 0) {
+        this_thread::sleep_for(milliseconds(1));
+    }
+    manager.Final(true);
+    assert(ran.load() == 0);
+    assert(remaining.load() > 0 && remaining.load() <= 1000);
+    assert(cancelled_inside.load());
+    assert(!TaskContext::Cancelled() && TaskContext::Current() == nullptr);
+    printf("cancel done: 110 tasks dropped, %ld ms left inside the task\n", (long)remaining.load());
+}
+
+template <typename QUEUE>
+void TestBulk(const char *name) {
+    constexpr size_t kTasks = 1 << 16;
+    constexpr size_t kBatch = 256;
+    Manager<Task, QUEUE> manager;
+    manager.Init(2, kTasks, 1, 10000);
+    // stall the workers, a quiet queue keeps the submit cost alone in the numbers
+    atomic<bool> release(false);
+    for (unsigned i = 0; i < 2; ++i) {
+        manager.Submit(i + 1, Task(i, steady_clock::now(), [&release]() {
+            while (!release.load()) {
+                this_thread::sleep_for(milliseconds(1));
+            }
+            return 0;
+        }));
+    }
+    atomic<size_t> done(0);
+    auto make = [&done](unsigned id) {
+        return Task(id, steady_clock::now(), [&done]() { return (int)done.fetch_add(1); });
+    };
+    vector<Task> tasks;
+    tasks.reserve(kTasks);
+    for (unsigned i = 0; i < kTasks; ++i) {
+        tasks.push_back(make(i));
+    }
+    auto begin = steady_clock::now();
+    for (size_t i = 0; i < kTasks / 2; ++i) {
+        manager.Submit(0, std::move(tasks[i]));
+    }
+    auto single = duration_cast<nanoseconds>(steady_clock::now() - begin).count() / (kTasks / 2);
+    begin = steady_clock::now();
+    size_t accepted = 0;
+    for (size_t i = kTasks / 2; i < kTasks; i += kBatch) {
+        accepted += manager.SubmitBulk(0, tasks.data() + i, kBatch);
+    }
+    auto bulk = duration_cast<nanoseconds>(steady_clock::now() - begin).count() / (kTasks / 2);
+    assert(accepted == kTasks / 2);
+    release = true;
+    while (done.load() < kTasks) {
+        this_thread::sleep_for(milliseconds(1));
+    }
+    manager.Final(true);
+    printf("%s bulk done: %ld ns per Submit, %ld ns per task with SubmitBulk(%zu)\n", name, (long)single,
+           (long)bulk, kBatch);
+}
+
+void TestBulkPartial() {
+    Manager<Task, MPMCQueue<Task>> manager;
+    manager.Init(1, 256, 1, 10000);
+    atomic<bool> release(false);
+    manager.Submit(0, Task(0, steady_clock::now(), [&release]() {
+        while (!release.load()) {
+            this_thread::sleep_for(milliseconds(1));
+        }
+        return 0;
+    }));
+    this_thread::sleep_for(milliseconds(10));
+    atomic<unsigned> done(0);
+    vector<Task> batch;
+    for (unsigned i = 0; i < 1000; ++i) {
+        batch.emplace_back(i, steady_clock::now(), [&done]() { return (int)done.fetch_add(1); });
+    }
+    auto accepted = manager.SubmitBulk(0, batch.data(), batch.size());
+    // the queue holds 256 tasks, the rest stays with the caller as it was and is counted
+    assert(accepted == 256 && manager.Rejections().dropped_newest == 744);
+    for (size_t i = accepted; i < batch.size(); ++i) {
+        assert(batch[i]._id == i && (bool)batch[i]._func);
+    }
+    release = true;
+    manager.Final(true);
+    assert(done.load() == accepted);
+    printf("bulk partial done: %zu of %zu accepted\n", accepted, batch.size());
+}
+
+void TestBackpressure() {
+    Manager<Task, MPMCQueue<Task>> manager;
+    manager.Init(1, 256, 1, 10000);
+    atomic<bool> release(false);
+    manager.Submit(0, Task(0, steady_clock::now(), [&release]() {
+        while (!release.load()) {
+            this_thread::sleep_for(milliseconds(1));
+        }
+        return 0;
+    }));
+    this_thread::sleep_for(milliseconds(10));
+    atomic<unsigned> done(0);
+    auto make = [&done](unsigned id) {
+        return Task(id, steady_clock::now(), [&done]() { return (int)done.fetch_add(1); });
+    };
+    for (unsigned i = 0; i < 256; ++i) {
+        assert(manager.Submit(i, make(i)));
+    }
+    // the queue is full from here on
+    assert(!manager.Submit(0, make(0)));
+    assert(manager.Rejections().dropped_newest == 1);
+
+    BackpressureOptions options;
+    options.policy = RejectPolicy::kCallerRuns;
+    manager.SetBackpressure(options);
+    auto before = done.load();
+    assert(manager.Submit(0, make(0)) && done.load() == before + 1);
+    assert(manager.Rejections().caller_runs == 1);
+
+    options.policy = RejectPolicy::kDropOldest;
+    manager.SetBackpressure(options);
+    assert(manager.Submit(0, make(0)));
+    assert(manager.Rejections().dropped_oldest == 1);
+
+    options.policy = RejectPolicy::kBlock;
+    options.block_ms = 20;
+    manager.SetBackpressure(options);
+    auto begin = steady_clock::now();
+    assert(!manager.Submit(0, make(0)));
+    assert(steady_clock::now() - begin >= milliseconds(20));
+    thread releaser([&release]() {
+        this_thread::sleep_for(milliseconds(5));
+        release = true;
+    });
+    assert(manager.Submit(0, make(0)));
+    releaser.join();
+    auto stats = manager.Rejections();
+    assert(stats.blocked == 2 && stats.block_timeouts == 1);
+    manager.Final(true);
+    // 256 queued - 1 dropped + 1 caller run + 1 after the drop + 1 after the wait
+    assert(done.load() == 258);
+
+    Manager<Task, MPSCQueue<Task>> throttled;
+    options = BackpressureOptions();
+    options.rate = 100;
+    options.burst = 10;
+    throttled.SetBackpressure(options);
+    throttled.Init(2, 1024, 1, 10000);
+    unsigned admitted = 0;
+    for (unsigned i = 0; i < 100; ++i) {
+        admitted += throttled.Submit(i, make(i)) ? 1 : 0;
+    }
+    throttled.Final(true);
+    printf("backpressure done: %u of 100 admitted at 100/s with a burst of 10, %lu throttled\n", admitted,
+           (unsigned long)throttled.Rejections().throttled);
+    assert(admitted >= 5 && admitted <= 20);
+    assert(admitted + throttled.Rejections().throttled == 100);
+}
+
+// a batch goes through the same admission and policy as single submits
+void TestBulkBackpressure() {
+    atomic<unsigned> done(0);
+    vector<Task> batch;
+    for (unsigned i = 0; i < 100; ++i) {
+        batch.emplace_back(i, steady_clock::now(), [&done]() { return (int)done.fetch_add(1); });
+    }
+    Manager<Task, MPMCQueue<Task>> throttled;
+    BackpressureOptions options;
+    options.rate = 100;
+    options.burst = 10;
+    throttled.SetBackpressure(options);
+    throttled.Init(2, 1024, 1, 10000);
+    auto admitted = throttled.SubmitBulk(0, batch.data(), batch.size());
+    throttled.Final(true);
+    assert(admitted >= 5 && admitted <= 20);
+    assert(admitted + throttled.Rejections().throttled == 100 && done.load() == admitted);
+    for (size_t i = admitted; i < batch.size(); ++i) {
+        assert(batch[i]._id == i && (bool)batch[i]._func);
+    }
+
+    // the strand holds 16 tasks, the running one included until it is done, the caller runs the rest
+    Manager<Task, MPSCQueue<Task>> strands;
+    options = BackpressureOptions();
+    options.policy = RejectPolicy::kCallerRuns;
+    strands.SetBackpressure(options);
+    strands.Init(1, 16, 1, 10000);
+    atomic<bool> release(false);
+    strands.Submit(1, Task(1, steady_clock::now(), [&release]() {
+        while (!release.load()) {
+            this_thread::sleep_for(milliseconds(1));
+        }
+        return 0;
+    }));
+    this_thread::sleep_for(milliseconds(10));
+    done = 0;
+    auto accepted = strands.SubmitBulk(1, batch.data() + admitted, batch.size() - admitted);
+    auto ran = done.load();
+    release = true;
+    strands.Final(true);
+    printf("bulk backpressure done: %zu of 100 admitted, %u run by the caller\n", admitted, ran);
+    assert(accepted == batch.size() - admitted && done.load() == accepted);
+    assert(strands.Rejections().caller_runs == ran && ran == accepted - 15);
+}
+
+class RoutingProbe : public Manager<Task, MPMCQueue<Task>> {
+public:
+    size_t Depth(unsigned idx) const {
+        return _queues[idx]->Size();
+    }
+};
+
+void TestRouting() {
+    constexpr unsigned kWorkers = 4;
+    constexpr unsigned kPerProducer = 1000;
+    RoutingProbe manager;
+    manager.Init(kWorkers, 4096, 1, 100000);
+    // park every worker inside a task so that the queues only grow
+    atomic<bool> release(false);
+    atomic<unsigned> blocked(0);
+    while (blocked.load() < kWorkers) {
+        manager.Submit(0, Task(0, steady_clock::now(), [&]() {
+            blocked.fetch_add(1);
+            while (!release.load()) {
+                this_thread::sleep_for(milliseconds(1));
+            }
+            return 0;
+        }));
+        this_thread::sleep_for(milliseconds(5));
+    }
+    vector<size_t> base(kWorkers);
+    for (unsigned idx = 0; idx < kWorkers; ++idx) {
+        base[idx] = manager.Depth(idx);
+    }
+    vector<thread> producers;
+    auto begin = steady_clock::now();
+    for (unsigned p = 0; p < kProducerNum; ++p) {
+        producers.emplace_back([&manager]() {
+            for (unsigned i = 0; i < kPerProducer; ++i) {
+                manager.Submit(i, Task(i, steady_clock::now(), []() { return 0; }));
+            }
+        });
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    auto cost = duration_cast<microseconds>(steady_clock::now() - begin).count();
+    size_t low = SIZE_MAX;
+    size_t high = 0;
+    for (unsigned idx = 0; idx < kWorkers; ++idx) {
+        auto depth = manager.Depth(idx) - base[idx];
+        low = min(low, depth);
+        high = max(high, depth);
+    }
+    release = true;
+    manager.Final(true);
+    printf("routing done: %zu submits by %zu producers in %ld us, per queue %zu..%zu\n",
+           kProducerNum * kPerProducer, kProducerNum, (long)cost, low, high);
+    assert(high - low <= kProducerNum * kPerProducer / kWorkers / 10);
+}
+
+template <typename QUEUE>
+void TestTimer(const char *name) {
+    Manager<Task, QUEUE> manager;
+    // sleep 0: a parked worker must wake up for its timers on its own; the delay is longer than the timeout
+    manager.Init(2, kQueueLength, 0, kTimeoutMs);
+    auto caller = this_thread::get_id();
+    atomic<int64_t> delay(-1);
+    atomic<bool> on_worker(false);
+    auto begin = steady_clock::now();
+    manager.SubmitAfter(milliseconds(150), 1, Task(1, begin, [&, begin]() {
+                            on_worker = this_thread::get_id() != caller && TaskContext::Current() != nullptr;
+                            delay = duration_cast<milliseconds>(steady_clock::now() - begin).count();
+                            return 0;
+                        }));
+    atomic<unsigned> ticks(0);
+    CancelSource source;
+    manager.SubmitEvery(milliseconds(10), 2, [&ticks]() { return (int)ticks.fetch_add(1); }, source.Token());
+    // cancelled before it is due, never runs
+    CancelSource never;
+    atomic<bool> ran(false);
+    manager.SubmitAfter(milliseconds(20), 3, Task(3, begin, [&ran]() { return (int)(ran = true); }, never.Token()));
+    never.Cancel();
+    while (delay.load() < 0) {
+        this_thread::sleep_for(milliseconds(1));
+    }
+    source.Cancel();
+    this_thread::sleep_for(milliseconds(30));
+    auto stopped = ticks.load();
+    this_thread::sleep_for(milliseconds(50));
+    manager.Final(true);
+    printf("%s timer done: one shot after %ld ms, %u periodic runs in 150 ms\n", name, (long)delay.load(), stopped);
+    assert(delay.load() >= 150 && delay.load() < 250);
+    assert(on_worker.load());
+    assert(!ran.load());
+    assert(stopped >= 5 && stopped <= 20);
+    assert(ticks.load() == stopped);
+}
+
+void TestCoalesce() {
+    Manager<Task, MPSCQueue<Task>> manager;
+    manager.Init(2, kQueueLength, 1, 10000);
+    // hold the strand of uid 7 so that the refreshes pile up behind it
+    atomic<bool> release(false);
+    manager.Submit(7, Task(7, steady_clock::now(), [&release]() {
+        while (!release.load()) {
+            this_thread::sleep_for(milliseconds(1));
+        }
+        return 0;
+    }));
+    atomic<unsigned> runs(0);
+    atomic<int> last(-1);
+    atomic<unsigned> other(0);
+    for (int i = 0; i < 100; ++i) {
+        manager.SubmitCoalesce(7, 1, Task(7, steady_clock::now(), [&, i]() {
+                                   runs.fetch_add(1);
+                                   last = i;
+                                   return 0;
+                               }));
+        manager.SubmitCoalesce(7, 2, Task(7, steady_clock::now(), [&other]() { return (int)other.fetch_add(1); }));
+    }
+    release = true;
+    manager.Final(true);
+    printf("coalesce done: 200 submits, %u + %u runs, %lu coalesced\n", runs.load(), other.load(),
+           (unsigned long)manager.Coalesced());
+    assert(runs.load() == 1 && last.load() == 99);
+    assert(other.load() == 1);
+    assert(manager.Coalesced() == 198);
+}
+
+// the task behind a key timed out while queued, the key must not keep swallowing later submits
+void TestCoalesceDropped() {
+    Manager<Task, MPSCQueue<Task>> manager;
+    manager.Init(1, kQueueLength, 1, 20);
+    atomic<bool> release(false);
+    manager.Submit(3, Task(3, steady_clock::now(), [&release]() {
+        while (!release.load()) {
+            this_thread::sleep_for(milliseconds(1));
+        }
+        return 0;
+    }));
+    atomic<int> stale(0);
+    atomic<int> fresh(0);
+    manager.SubmitCoalesce(3, 1, Task(3, steady_clock::now(), [&stale]() { return stale.fetch_add(1); }));
+    this_thread::sleep_for(milliseconds(50));
+    release = true;
+    this_thread::sleep_for(milliseconds(20));
+    assert(manager.SubmitCoalesce(3, 1, Task(3, steady_clock::now(), [&fresh]() { return fresh.fetch_add(1); })));
+    this_thread::sleep_for(milliseconds(20));
+    manager.Final(true);
+    printf("coalesce dropped done: stale %d fresh %d\n", stale.load(), fresh.load());
+    assert(stale.load() == 0 && fresh.load() == 1);
+}
+
+template <typename QUEUE>
+void TestPlacement(const char *name) {
+    auto &topology = CpuTopology::Get();
+    assert(topology.Cpus().size() == AllowedCpus().size());
+    auto order = topology.PlacementOrder();
+    assert(order.size() == topology.Cpus().size());
+    assert(topology.Distance(order[0], order[0]) == 0);
+    // unreadable sysfs: every cpu is its own core on one cache and one node
+    CpuTopology blind({0, 1, 2}, "/nonexistent");
+    assert(blind.Distance(0, 1) == 2 && blind.PlacementOrder().size() == 3);
+
+    Manager<Task, QUEUE> manager;
+    manager.SetPlacement(PlacementOptions{true, name});
+    manager.Init(4, kQueueLength, 1, kTimeoutMs);
+    mutex lock;
+    set<string> names;
+    set<int> cpus;
+    atomic<unsigned> ran(0);
+    for (unsigned i = 0; i < 64; ++i) {
+        manager.Submit(i, Task(i, steady_clock::now(), [&]() {
+                           char buffer[16] = {0};
+                           pthread_getname_np(pthread_self(), buffer, sizeof(buffer));
+                           lock_guard<mutex> guard(lock);
+                           names.insert(buffer);
+                           cpus.insert(sched_getcpu());
+                           return (int)ran.fetch_add(1);
+                       }));
+    }
+    // Final(true) would run what is left on this (unnamed) thread
+    while (ran.load() < 64) {
+        this_thread::sleep_for(milliseconds(1));
+    }
+    manager.Final(true);
+    printf("%s placement done: %zu cpus allowed, tasks ran on %zu cpus by %zu named workers\n", name,
+           topology.Cpus().size(), cpus.size(), names.size());
+    assert(ran.load() == 64);
+    for (auto &worker : names) {
+        assert(worker.compare(0, strlen(name), name) == 0);
+    }
+    for (auto cpu : cpus) {
+        assert(find(order.begin(), order.end(), cpu) != order.end());
+    }
+}
+
 int main() {
     TestMPMCManager();
     TestMPSCManager();
+    TestStealingManager();
+    TestStealingImbalance();
+    TestElastic();
+    TestPriority();
+    TestStrand();
+    TestParking<MPMCQueue<Task>>("mpmc");
+    TestParking<MPSCQueue<Task>>("mpsc");
+    TestParking<WorkStealingDeque<Task *>>("stealing");
+    TestParking<PriorityLanes<MPMCQueue<Task>>>("priority");
+    TestCancel();
+    TestBulk<MPMCQueue<Task>>("mpmc");
+    TestBulk<MPSCQueue<Task>>("mpsc");
+    TestBulkPartial();
+    TestBackpressure();
+    TestBulkBackpressure();
+    TestRouting();
+    TestTimer<MPMCQueue<Task>>("mpmc");
+    TestTimer<MPSCQueue<Task>>("mpsc");
+    TestCoalesce();
+    TestCoalesceDropped();
+    TestPlacement<MPMCQueue<Task>>("mpmc");
+    TestPlacement<MPSCQueue<Task>>("mpsc");
     this_thread::sleep_for(seconds(2));
     return 0;
 }
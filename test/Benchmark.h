@@ -0,0 +1,217 @@
+/**
+ * Helpers shared by the benchmark targets: a log-linear latency histogram,
+ * thread pinning and a tiny table/csv/json report writer.
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ThreadAffinity.h"
+
+namespace bench {
+
+inline int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * Buckets are grouped by power of two, each group is split into 2^kSubBits linear
+ * sub-buckets, so the relative error of a recorded value is below 2^-kSubBits.
+ */
+class Histogram {
+public:
+    Histogram()
+        : _counts()
+        , _total(0)
+        , _sum(0)
+        , _min(INT64_MAX)
+        , _max(0) {}
+
+public:
+    void Record(int64_t value) {
+        if (value < 0) {
+            value = 0;
+        }
+        ++_counts[index(value)];
+        ++_total;
+        _sum += (double)value;
+        _min = std::min(_min, value);
+        _max = std::max(_max, value);
+    }
+
+    void Merge(const Histogram &other) {
+        for (size_t i = 0; i < kBuckets; ++i) {
+            _counts[i] += other._counts[i];
+        }
+        _total += other._total;
+        _sum += other._sum;
+        _min = std::min(_min, other._min);
+        _max = std::max(_max, other._max);
+    }
+
+    // p in [0, 100]
+    int64_t Percentile(double p) const {
+        if (_total == 0) {
+            return 0;
+        }
+        auto rank = (uint64_t)std::ceil(p / 100.0 * (double)_total);
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            seen += _counts[i];
+            if (seen >= rank) {
+                return std::min(upper(i), _max);
+            }
+        }
+        return _max;
+    }
+
+    uint64_t Count() const {
+        return _total;
+    }
+
+    int64_t Min() const {
+        return _total == 0 ? 0 : _min;
+    }
+
+    int64_t Max() const {
+        return _max;
+    }
+
+    double Mean() const {
+        return _total == 0 ? 0.0 : _sum / (double)_total;
+    }
+
+private:
+    static constexpr unsigned kSubBits = 7;
+    static constexpr unsigned kSubCount = 1u << kSubBits;
+    static constexpr unsigned kGroups = 64 - kSubBits;
+    static constexpr size_t kBuckets = (size_t)(kGroups + 1) * kSubCount;
+
+    static size_t index(int64_t value) {
+        auto v = (uint64_t)value;
+        if (v < kSubCount) {
+            return (size_t)v;
+        }
+        auto group = (unsigned)(63 - __builtin_clzll(v)) - kSubBits + 1;
+        auto sub = (size_t)(v >> (group - 1)) - kSubCount;
+        return (size_t)group * kSubCount + sub;
+    }
+
+    // the largest value that falls into bucket i
+    static int64_t upper(size_t i) {
+        auto group = (unsigned)(i / kSubCount);
+        auto sub = (uint64_t)(i % kSubCount);
+        if (group == 0) {
+            return (int64_t)sub;
+        }
+        return (int64_t)((((sub + kSubCount) + 1) << (group - 1)) - 1);
+    }
+
+private:
+    std::array<uint64_t, kBuckets> _counts;
+    uint64_t _total;
+    double _sum;
+    int64_t _min;
+    int64_t _max;
+};
+
+// pin the calling thread to the slot-th allowed cpu
+using scorpion::PinThread;
+
+/**
+ * Collects rows of named columns and prints them as an aligned table, csv or json.
+ */
+class Report {
+public:
+    using Row = std::vector<std::pair<std::string, std::string>>;
+
+public:
+    void Add(Row row) {
+        _rows.push_back(std::move(row));
+    }
+
+    void Print(const std::string &format, FILE *out) const {
+        if (format == "csv") {
+            printCsv(out);
+        } else if (format == "json") {
+            printJson(out);
+        } else {
+            printTable(out);
+        }
+        fflush(out);
+    }
+
+private:
+    void printCsv(FILE *out) const {
+        if (_rows.empty()) {
+            return;
+        }
+        for (size_t i = 0; i < _rows[0].size(); ++i) {
+            fprintf(out, "%s%s", i == 0 ? "" : ",", _rows[0][i].first.c_str());
+        }
+        fprintf(out, "\n");
+        for (const auto &row : _rows) {
+            for (size_t i = 0; i < row.size(); ++i) {
+                fprintf(out, "%s%s", i == 0 ? "" : ",", row[i].second.c_str());
+            }
+            fprintf(out, "\n");
+        }
+    }
+
+    void printJson(FILE *out) const {
+        fprintf(out, "[\n");
+        for (size_t r = 0; r < _rows.size(); ++r) {
+            fprintf(out, "  {");
+            for (size_t i = 0; i < _rows[r].size(); ++i) {
+                const auto &cell = _rows[r][i];
+                bool number = !cell.second.empty() &&
+                              cell.second.find_first_not_of("0123456789.-") == std::string::npos;
+                fprintf(out, "%s\"%s\": %s%s%s", i == 0 ? "" : ", ", cell.first.c_str(), number ? "" : "\"",
+                        cell.second.c_str(), number ? "" : "\"");
+            }
+            fprintf(out, "}%s\n", r + 1 == _rows.size() ? "" : ",");
+        }
+        fprintf(out, "]\n");
+    }
+
+    void printTable(FILE *out) const {
+        if (_rows.empty()) {
+            return;
+        }
+        std::vector<size_t> width(_rows[0].size(), 0);
+        for (size_t i = 0; i < width.size(); ++i) {
+            width[i] = _rows[0][i].first.size();
+            for (const auto &row : _rows) {
+                width[i] = std::max(width[i], row[i].second.size());
+            }
+        }
+        for (size_t i = 0; i < width.size(); ++i) {
+            fprintf(out, "%-*s  ", (int)width[i], _rows[0][i].first.c_str());
+        }
+        fprintf(out, "\n");
+        for (const auto &row : _rows) {
+            for (size_t i = 0; i < width.size(); ++i) {
+                fprintf(out, "%-*s  ", (int)width[i], row[i].second.c_str());
+            }
+            fprintf(out, "\n");
+        }
+    }
+
+private:
+    std::vector<Row> _rows;
+};
+
+} // namespace bench
@@ -0,0 +1,77 @@
+#include "ConcurrentQueue.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace scorpion;
+
+constexpr const int kProducerNum = 4;
+constexpr const int kTestCounter = 100000;
+
+void TestOrder() {
+    ConcurrentQueue<int> q(4);
+    vector<int> out;
+    for (int round = 0; round < 3; ++round) {
+        // wrap the ring around before draining
+        for (int i = 0; i < 3; ++i) {
+            q.Push(-1);
+        }
+        for (int i = 0; i < 3; ++i) {
+            assert(q.Pop() == -1);
+        }
+        for (int i = 0; i < 100; ++i) {
+            q.Push(i);
+        }
+        assert(q.DrainAll(out) == 100);
+        for (int i = 0; i < 100; ++i) {
+            assert(out[(size_t)i] == i);
+        }
+        assert(q.Empty() && !q.TryPop().has_value());
+    }
+    printf("order done!\n");
+}
+
+void TestDrain() {
+    ConcurrentQueue<int> q;
+    vector<thread> producers;
+    for (int id = 0; id < kProducerNum; ++id) {
+        producers.emplace_back([&q]() {
+            for (int i = 1; i <= kTestCounter; ++i) {
+                q.Push(i);
+            }
+        });
+    }
+
+    long long sum = 0;
+    size_t count = 0;
+    size_t drains = 0;
+    vector<int> out;
+    while (count < (size_t)kProducerNum * kTestCounter) {
+        auto n = q.DrainAll(out);
+        if (n == 0) {
+            sum += q.Pop(); // park until the next push
+            ++count;
+            continue;
+        }
+        for (auto v : out) {
+            sum += v;
+        }
+        count += n;
+        ++drains;
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    assert(sum == (long long)kProducerNum * kTestCounter * (kTestCounter + 1) / 2);
+    printf("drain done: %zu elements in %zu drains\n", count, drains);
+}
+
+int main() {
+    TestOrder();
+    TestDrain();
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include "EventQueue.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "Epoller.h"
+#include "MPMCQueue.h"
+#include "SPSCQueue.h"
+#include "UnixSocket.h"
+
+using namespace std;
+using namespace scorpion;
+using namespace Scorpion;
+
+constexpr const char *CLI = "/tmp/event_queue_client.sox";
+constexpr const char *SVR = "/tmp/event_queue_server.sox";
+constexpr const unsigned int LEN = 16;
+constexpr const size_t kQueueSize = 1024;
+constexpr const size_t kProducerNum = 4;
+constexpr const size_t kTestCounter = 100000;
+constexpr const size_t kMessageNum = 100;
+
+template <typename Queue>
+void TestQueueOnly(size_t producer_num) {
+    Queue queue(kQueueSize);
+    Epoller poller;
+    poller.Create();
+
+    size_t popped = 0;
+    size_t wakeups = 0;
+    poller.Add(queue.Fd(), EPOLLIN, [&](uint32_t) {
+        ++wakeups;
+        popped += queue.Consume([](size_t) {}, 256);
+    });
+
+    vector<thread> producers;
+    for (size_t id = 0; id < producer_num; ++id) {
+        producers.emplace_back([&queue]() {
+            for (size_t i = 0; i < kTestCounter; ++i) {
+                while (!queue.TryPush(i)) {
+                    this_thread::yield();
+                }
+            }
+        });
+    }
+    while (popped < producer_num * kTestCounter) {
+        poller.Poll(1000);
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    printf("done: pop %zu with %zu wakeups\n", popped, wakeups);
+}
+
+void TestMultiplex() {
+    EventQueue<size_t, MPSCQueue<size_t>> queue(kQueueSize);
+    UnixServer svr(SVR);
+    if (svr.Create() != 0 || svr.Listen() != 0) {
+        printf("[%s] server fail\n", __func__);
+        return;
+    }
+
+    thread client([]() {
+        UnixClient cli(CLI);
+        if (cli.Create() != 0 || cli.Connect(SVR) != 0) {
+            printf("[TestMultiplex] client fail\n");
+            return;
+        }
+        char buffer[LEN];
+        memset(buffer, 'A', LEN);
+        for (size_t i = 0; i < kMessageNum; ++i) {
+            cli.Send(buffer, LEN);
+            this_thread::sleep_for(chrono::microseconds(100));
+        }
+    });
+    auto conn = svr.Accept();
+    if (conn == nullptr) {
+        printf("[%s] accept fail\n", __func__);
+        client.join();
+        return;
+    }
+
+    vector<thread> producers;
+    for (size_t id = 0; id < kProducerNum; ++id) {
+        producers.emplace_back([&queue]() {
+            for (size_t i = 0; i < kTestCounter; ++i) {
+                while (!queue.TryPush(i)) {
+                    this_thread::yield();
+                }
+            }
+        });
+    }
+
+    Epoller poller;
+    poller.Create();
+    size_t messages = 0;
+    size_t popped = 0;
+    poller.Add(conn->GetFd(), EPOLLIN, [&](uint32_t) {
+        char buffer[LEN];
+        if (conn->Recv(buffer, LEN) == LEN) {
+            ++messages;
+        } else {
+            poller.Del(conn->GetFd());
+        }
+    });
+    poller.Add(queue.Fd(), EPOLLIN, [&](uint32_t) { popped += queue.Consume([](size_t) {}); });
+    while (messages < kMessageNum || popped < kProducerNum * kTestCounter) {
+        poller.Poll(1000);
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+    client.join();
+    printf("done: recv %zu messages and pop %zu elements on one loop\n", messages, popped);
+}
+
+int main() {
+    TestQueueOnly<EventQueue<size_t, SPSCQueue<size_t>>>(1);
+    TestQueueOnly<EventQueue<size_t, MPSCQueue<size_t>>>(kProducerNum);
+    TestQueueOnly<EventQueue<size_t, MPMCQueue<size_t>>>(kProducerNum);
+    TestMultiplex();
+    return 0;
+}
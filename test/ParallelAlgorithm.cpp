@@ -0,0 +1,119 @@
+#include "ParallelAlgorithm.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "StealingTaskPool.h"
+
+using namespace std;
+using namespace scorpion;
+
+template <typename Pool>
+void TestFor(Pool &pool) {
+    vector<atomic<int>> hits(100000);
+    ParallelFor(pool, 0, hits.size(), [&](size_t i) { hits[i].fetch_add(1); });
+    for (auto &hit : hits) {
+        assert(hit.load() == 1);
+    }
+    // empty and tiny ranges
+    ParallelFor(pool, 5, 5, [](size_t) { assert(false); });
+    int once = 0;
+    ParallelFor(pool, 0, 1, [&](size_t) { ++once; });
+    assert(once == 1);
+    printf("for done!\n");
+}
+
+template <typename Pool>
+void TestTransformReduce(Pool &pool) {
+    vector<long> in(1000000);
+    iota(in.begin(), in.end(), 0);
+    vector<long> out(in.size());
+    ParallelTransform(pool, in.begin(), in.end(), out.begin(), [](long v) { return v * 2; });
+    for (size_t i = 0; i < in.size(); ++i) {
+        assert(out[i] == in[i] * 2);
+    }
+    auto sum = ParallelReduce(pool, out.begin(), out.end(), 0L);
+    assert(sum == (long)in.size() * ((long)in.size() - 1));
+    auto max = ParallelReduce(pool, in.begin(), in.end(), -1L, [](long a, long b) { return std::max(a, b); });
+    assert(max == (long)in.size() - 1);
+    printf("transform reduce done!\n");
+}
+
+template <typename Pool>
+void TestSort(Pool &pool) {
+    mt19937 rng(42);
+    for (size_t n : {0ul, 1ul, 1000ul, 100000ul, 1000003ul}) {
+        vector<int> data(n);
+        for (auto &v : data) {
+            v = (int)(rng() % 1000);
+        }
+        auto expect = data;
+        sort(expect.begin(), expect.end());
+        auto begin = chrono::steady_clock::now();
+        ParallelSort(pool, data.begin(), data.end());
+        auto cost = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - begin).count();
+        assert(data == expect);
+        printf("sort %zu ints in %ld us\n", n, (long)cost);
+    }
+    vector<string> words(50000);
+    for (auto &word : words) {
+        word = to_string(rng());
+    }
+    ParallelSort(pool, words.begin(), words.end(), greater<>(), 1000);
+    assert(is_sorted(words.begin(), words.end(), greater<>()));
+    printf("sort done!\n");
+}
+
+template <typename Pool>
+void TestError(Pool &pool) {
+    atomic<size_t> ran(0);
+    try {
+        ParallelFor(
+            pool, 0, 100000,
+            [&](size_t i) {
+                ran.fetch_add(1);
+                if (i == 500) {
+                    throw runtime_error("bad element");
+                }
+            },
+            100);
+        assert(false);
+    } catch (runtime_error &e) {
+        printf("exception passed through: %s after %zu elements\n", e.what(), ran.load());
+    }
+}
+
+int main() {
+    {
+        printf("==== thread pool ====\n");
+        ThreadPool pool(4);
+        TestFor(pool);
+        TestTransformReduce(pool);
+        TestSort(pool);
+        TestError(pool);
+        // nested loops: the inner caller keeps working even if every worker is busy
+        atomic<int> total(0);
+        ParallelFor(
+            pool, 0, 8, [&](size_t) { ParallelFor(pool, 0, 1000, [&](size_t) { total.fetch_add(1); }); }, 1);
+        assert(total == 8000);
+    }
+    {
+        printf("==== stealing pool ====\n");
+        Manager<Task, WorkStealingDeque<Task *>> pool;
+        pool.Init(4, 1024, 1, 10000);
+        TestFor(pool);
+        TestTransformReduce(pool);
+        TestSort(pool);
+        TestError(pool);
+        pool.Final(true);
+    }
+    return 0;
+}
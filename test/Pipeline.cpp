@@ -0,0 +1,116 @@
+#include "Pipeline.h"
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace chrono;
+using namespace scorpion;
+
+constexpr const size_t kTestCounter = 200000;
+
+struct Record {
+    size_t id;
+    string text;
+};
+
+template <bool Dedicated>
+void TestChain() {
+    Pipeline pipe(2);
+    StageOptions options;
+    options.capacity = 256;
+    options.batch = 32;
+    options.dedicated = Dedicated;
+
+    auto source = pipe.Source<size_t>(1024);
+    auto parsed = pipe.Then<Record>(
+        "parse", source,
+        [](size_t &in, Record &out) {
+            out.id = in;
+            out.text = to_string(in);
+            return true;
+        },
+        options);
+    auto enriched = pipe.Then<Record>(
+        "enrich", parsed,
+        [](Record &in, Record &out) {
+            if (in.id % 10 == 0) {
+                return false; // filtered
+            }
+            out = std::move(in);
+            out.text += "!";
+            return true;
+        },
+        options);
+    size_t count = 0;
+    size_t sum = 0;
+    pipe.Sink<Record>(
+        "emit", enriched,
+        [&](Record &in) {
+            ++count;
+            sum += in.id;
+            if (in.id % 50000 == 1) {
+                this_thread::sleep_for(milliseconds(10)); // slow sink -> backpressure
+            }
+        },
+        options);
+    assert(!pipe.Sink<size_t>("again", source, [](size_t &) {})); // a ring has one consumer
+
+    pipe.Start();
+    size_t full = 0;
+    for (size_t i = 1; i <= kTestCounter; ++i) {
+        while (!source.TryPush(i)) {
+            ++full;
+            this_thread::yield();
+        }
+    }
+    pipe.Dump();
+    pipe.Stop();
+    pipe.Dump();
+
+    size_t expect = 0;
+    for (size_t i = 1; i <= kTestCounter; ++i) {
+        expect += i % 10 == 0 ? 0 : i;
+    }
+    assert(count == kTestCounter - kTestCounter / 10 && sum == expect);
+    printf("%s done: %zu emitted, source full %zu times\n", Dedicated ? "dedicated" : "shared", count, full);
+}
+
+void TestNoExecutor() {
+    Pipeline pipe(0);
+    StageOptions options;
+    options.dedicated = false;
+    auto source = pipe.Source<size_t>(16);
+    pipe.Sink<size_t>("drop", source, [](size_t &) {}, options);
+    // nothing would ever run the shared stage
+    assert(!pipe.Start());
+    pipe.Stop();
+    printf("no executor done\n");
+}
+
+void TestUnconsumed() {
+    Pipeline pipe(1);
+    auto source = pipe.Source<size_t>(16);
+    auto doubled = pipe.Then<size_t>("double", source, [](size_t &in, size_t &out) {
+        out = in * 2;
+        return true;
+    });
+    // nothing drains doubled, the stage would stall once its ring is full and Stop() would never return
+    assert(!pipe.Start());
+    pipe.Sink<size_t>("drop", doubled, [](size_t &) {});
+    assert(pipe.Start());
+    pipe.Stop();
+    // the sources are closed for good
+    assert(!pipe.Start());
+    printf("unconsumed done\n");
+}
+
+int main() {
+    TestChain<true>();
+    TestChain<false>();
+    TestNoExecutor();
+    TestUnconsumed();
+    return 0;
+}
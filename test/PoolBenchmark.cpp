@@ -0,0 +1,288 @@
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncTaskPool.h"
+#include "Benchmark.h"
+#include "CmdLine.h"
+#include "Executor.h"
+#include "StealingTaskPool.h"
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace scorpion;
+
+struct Config {
+    string pool;
+    unsigned workers;
+    unsigned rate;     // target submits per second
+    unsigned duration; // ms of load per rate
+    unsigned work;     // ns of busy work per task
+    unsigned slo;      // us, a start p99 above it counts as saturated
+};
+
+// a Manager behind the Executor interface, one uid per task so that the strand pool is not serialized
+template <typename QUEUE>
+class SpreadExecutor : public Executor {
+public:
+    SpreadExecutor(unsigned workers, unsigned queue_len)
+        : _uid(0) {
+        _manager.Init(workers, queue_len, 1, 60 * 1000);
+    }
+
+    ~SpreadExecutor() override {
+        _manager.Final(true);
+    }
+
+public:
+    bool Execute(Callback cb) override {
+        auto uid = _uid.fetch_add(1, memory_order_relaxed);
+        return _manager.Submit(uid, Task(uid, chrono::steady_clock::now(), std::move(cb)));
+    }
+
+    unsigned Concurrency() const override {
+        return _manager.Size();
+    }
+
+private:
+    Manager<Task, QUEUE> _manager;
+    atomic<unsigned> _uid;
+};
+
+// the default executor is shared, it is borrowed and never stopped: destroying it neither drains nor joins
+class Borrowed : public Executor {
+public:
+    explicit Borrowed(Executor &executor)
+        : _executor(executor) {}
+
+public:
+    bool Execute(Callback cb) override {
+        return _executor.Execute(std::move(cb));
+    }
+
+    unsigned Concurrency() const override {
+        return _executor.Concurrency();
+    }
+
+private:
+    Executor &_executor;
+};
+
+unique_ptr<Executor> createPool(const Config &config) {
+    constexpr unsigned kQueueLength = 1 << 16;
+    if (config.pool == "threadpool") {
+        return unique_ptr<Executor>(new ThreadPool(config.workers));
+    }
+    if (config.pool == "mpmc") {
+        return unique_ptr<Executor>(new SpreadExecutor<MPMCQueue<Task>>(config.workers, kQueueLength));
+    }
+    if (config.pool == "strand") {
+        return unique_ptr<Executor>(new SpreadExecutor<MPSCQueue<Task>>(config.workers, kQueueLength));
+    }
+    if (config.pool == "stealing") {
+        return unique_ptr<Executor>(new SpreadExecutor<WorkStealingDeque<Task *>>(config.workers, kQueueLength));
+    }
+    if (config.pool == "default") {
+        return unique_ptr<Executor>(new Borrowed(DefaultExecutor()));
+    }
+    printf("[Warn] unknown pool %s\n", config.pool.c_str());
+    return nullptr;
+}
+
+/**
+ * Open loop: task i is due at begin + i * interval whether or not the pool kept up, and its latencies are
+ * taken from that due time, not from when the generator got to submit it. A stalled submitter (full queue,
+ * descheduled generator) therefore shows up as latency instead of as fewer slow samples (coordinated
+ * omission); a late generator submits the backlog at once rather than skipping it.
+ */
+class OpenLoop {
+public:
+    explicit OpenLoop(const Config &config)
+        : _config(config)
+        , _count((size_t)config.rate * config.duration / 1000)
+        , _state(make_shared<State>(_count)) {}
+
+public:
+    // false if the pool could not be created
+    bool Run(bench::Report &report) {
+        auto interval = 1000000000 / (int64_t)_config.rate;
+        size_t accepted = 0;
+        {
+            auto pool = createPool(_config);
+            if (pool == nullptr) {
+                return false;
+            }
+            auto begin = bench::NowNs() + 1000000; // let the workers settle
+            for (size_t idx = 0; idx < _count; ++idx) {
+                auto due = begin + (int64_t)idx * interval;
+                while (bench::NowNs() < due) {
+                    // spinning keeps the schedule tight, sleeping would add its own jitter
+                }
+                auto state = _state;
+                auto work = (int64_t)_config.work;
+                if (pool->Execute([state, idx, due, work]() { return task(*state, idx, due, work); })) {
+                    ++accepted;
+                }
+            }
+            // an owned pool drains its queue and joins when it is destroyed, a borrowed one does neither:
+            // wait for every accepted task or summarize() would race the stragglers
+            auto borrowed = dynamic_cast<Borrowed *>(pool.get()) != nullptr;
+            auto deadline = bench::NowNs() + 10 * 1000000000LL;
+            while (_state->done.load(memory_order_acquire) < accepted && (borrowed || bench::NowNs() < deadline)) {
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+        }
+        report.Add(summarize(accepted));
+        return true;
+    }
+
+    bool Saturated() const {
+        return _saturated;
+    }
+
+private:
+    struct Sample {
+        int64_t start = -1;
+        int64_t finish = -1;
+    };
+
+    // shared with the tasks, none of them touches the OpenLoop
+    struct State {
+        explicit State(size_t count)
+            : samples(count)
+            , done(0) {}
+
+        vector<Sample> samples;
+        atomic<size_t> done;
+    };
+
+    static int task(State &state, size_t idx, int64_t due, int64_t work) {
+        auto start = bench::NowNs();
+        while (bench::NowNs() - start < work) {
+            // busy work
+        }
+        state.samples[idx].start = start - due;
+        state.samples[idx].finish = bench::NowNs() - due;
+        state.done.fetch_add(1, memory_order_release);
+        return 0;
+    }
+
+    bench::Report::Row summarize(size_t accepted) {
+        bench::Histogram start;
+        bench::Histogram finish;
+        int64_t last = 0;
+        for (const auto &sample : _state->samples) {
+            if (sample.finish < 0) {
+                continue;
+            }
+            start.Record(sample.start);
+            finish.Record(sample.finish);
+            last = max(last, sample.finish);
+        }
+        // tasks were due over duration ms, the slowest finished last ns after its due time
+        auto span = (double)((int64_t)_config.duration * 1000000 + last) / 1e9;
+        auto achieved = span > 0 ? (double)finish.Count() / span : 0.0;
+        _saturated = achieved < 0.95 * _config.rate || accepted < _count ||
+                     start.Percentile(99.0) > (int64_t)_config.slo * 1000;
+
+        auto us = [](int64_t ns) { return to_string(ns / 1000); };
+        bench::Report::Row row;
+        row.emplace_back("pool", _config.pool);
+        row.emplace_back("workers", to_string(_config.workers));
+        row.emplace_back("target_rate", to_string(_config.rate));
+        row.emplace_back("achieved_rate", to_string((uint64_t)achieved));
+        row.emplace_back("rejected", to_string(_count - accepted));
+        row.emplace_back("start_p50_us", us(start.Percentile(50.0)));
+        row.emplace_back("start_p99_us", us(start.Percentile(99.0)));
+        row.emplace_back("start_p999_us", us(start.Percentile(99.9)));
+        row.emplace_back("finish_p50_us", us(finish.Percentile(50.0)));
+        row.emplace_back("finish_p99_us", us(finish.Percentile(99.0)));
+        row.emplace_back("finish_p999_us", us(finish.Percentile(99.9)));
+        row.emplace_back("max_us", us(finish.Max()));
+        row.emplace_back("saturated", _saturated ? "yes" : "no");
+        return row;
+    }
+
+private:
+    const Config _config;
+    const size_t _count;
+    shared_ptr<State> _state;
+    bool _saturated = false;
+};
+
+// "a,b,c" -> {a, b, c}
+vector<string> split(const string &text) {
+    vector<string> values;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        auto end = text.find(',', begin);
+        if (end == string::npos) {
+            end = text.size();
+        }
+        values.push_back(text.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return values;
+}
+
+int main(int argc, char *argv[]) {
+    cmdline::parser parser;
+    parser.add<string>("pools", 'p', "pools to run (threadpool,mpmc,strand,stealing,default)", false,
+                       "threadpool,mpmc,strand");
+    parser.add<string>("rates", 'r', "target submits per second to sweep, ascending", false,
+                       "10000,20000,50000,100000,200000,500000");
+    parser.add<unsigned>("workers", 'w', "workers per pool", false, 4);
+    parser.add<unsigned>("duration", 'd', "ms of load per rate", false, 200);
+    parser.add<unsigned>("work", 'n', "ns of busy work per task", false, 1000);
+    parser.add<unsigned>("slo", 's', "start p99 in us above which a pool counts as saturated", false, 10000);
+    parser.add<string>("format", 'f', "output format (table,csv,json)", false, "table");
+    parser.add<string>("output", 'o', "output file, stdout if empty", false, "");
+    parser.add("no-stop", 0, "keep sweeping once a pool is saturated");
+    parser.parse_check(argc, argv);
+
+    bench::Report report;
+    vector<unsigned> rates;
+    for (const auto &rate : split(parser.get<string>("rates"))) {
+        rates.push_back((unsigned)stoul(rate));
+    }
+    for (const auto &pool : split(parser.get<string>("pools"))) {
+        for (auto rate : rates) {
+            if (rate == 0) {
+                continue;
+            }
+            Config config{pool,
+                          parser.get<unsigned>("workers"),
+                          rate,
+                          parser.get<unsigned>("duration"),
+                          parser.get<unsigned>("work"),
+                          parser.get<unsigned>("slo")};
+            OpenLoop test(config);
+            if (!test.Run(report)) {
+                break;
+            }
+            // past saturation the queue only grows, higher rates tell nothing new
+            if (test.Saturated() && !parser.exist("no-stop")) {
+                break;
+            }
+        }
+    }
+
+    FILE *out = stdout;
+    auto output = parser.get<string>("output");
+    if (!output.empty()) {
+        out = fopen(output.c_str(), "w");
+        if (out == nullptr) {
+            printf("open %s err %d %s\n", output.c_str(), errno, strerror(errno));
+            return -1;
+        }
+    }
+    report.Print(parser.get<string>("format"), out);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,292 @@
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+#include "BlockingQueue.h"
+#include "CmdLine.h"
+#include "ConcurrentQueue.h"
+#include "MPMCQueue.h"
+#include "MPSCQueue.h"
+#include "SPSCQueue.h"
+
+using namespace std;
+using namespace scorpion;
+
+template <size_t N>
+struct Payload {
+    static_assert(N >= 2 * sizeof(int64_t), "payload carries a sequence and a timestamp");
+
+    int64_t seq;
+    int64_t ts;
+    char pad[N - 2 * sizeof(int64_t)];
+
+    Payload() noexcept
+        : seq(0)
+        , ts(0)
+        , pad() {}
+
+    Payload(int64_t s, int64_t t) noexcept
+        : seq(s)
+        , ts(t)
+        , pad() {}
+};
+
+// unify the push/pop interface of the queues under test
+template <typename Queue>
+struct QueueOps {
+    static unique_ptr<Queue> Create(size_t capacity) {
+        return unique_ptr<Queue>(new Queue(capacity));
+    }
+    template <typename T>
+    static bool TryPush(Queue *q, const T &v) {
+        return q->TryPush(v);
+    }
+    template <typename T>
+    static bool TryPop(Queue *q, T &v) {
+        return q->TryPop(v);
+    }
+};
+
+template <typename T>
+struct QueueOps<BlockingQueue<T>> {
+    static unique_ptr<BlockingQueue<T>> Create(size_t capacity) {
+        return unique_ptr<BlockingQueue<T>>(new BlockingQueue<T>(capacity));
+    }
+    static bool TryPush(BlockingQueue<T> *q, const T &v) {
+        q->Push(v); // blocks while full
+        return true;
+    }
+    static bool TryPop(BlockingQueue<T> *q, T &v) {
+        return q->TryPop(v);
+    }
+};
+
+template <typename T>
+struct QueueOps<ConcurrentQueue<T>> {
+    static unique_ptr<ConcurrentQueue<T>> Create(size_t) {
+        return unique_ptr<ConcurrentQueue<T>>(new ConcurrentQueue<T>()); // unbounded
+    }
+    static bool TryPush(ConcurrentQueue<T> *q, const T &v) {
+        q->Push(v);
+        return true;
+    }
+    static bool TryPop(ConcurrentQueue<T> *q, T &v) {
+        return q->TryPop(v);
+    }
+};
+
+struct Config {
+    string queue;
+    unsigned producers;
+    unsigned consumers;
+    size_t capacity;
+    size_t payload;
+    size_t messages;
+    bool pin;
+};
+
+template <typename Queue, typename T>
+class QueueBench {
+public:
+    explicit QueueBench(const Config &config)
+        : _config(config)
+        , _queue(QueueOps<Queue>::Create(config.capacity))
+        , _ready(0)
+        , _start(false)
+        , _popped(0)
+        , _histograms(config.consumers) {}
+
+public:
+    bench::Report::Row Run() {
+        vector<thread> threads;
+        unsigned slot = 0;
+        for (unsigned id = 0; id < _config.consumers; ++id) {
+            threads.emplace_back(&QueueBench::consumer, this, id, slot++);
+        }
+        for (unsigned id = 0; id < _config.producers; ++id) {
+            threads.emplace_back(&QueueBench::producer, this, id, slot++);
+        }
+        while (_ready.load() != threads.size()) {
+            this_thread::yield();
+        }
+        auto begin = bench::NowNs();
+        _start.store(true, memory_order_release);
+        for (auto &t : threads) {
+            t.join();
+        }
+        auto elapsed = bench::NowNs() - begin;
+
+        bench::Histogram latency;
+        for (const auto &h : _histograms) {
+            latency.Merge(h);
+        }
+        auto total = (double)latency.Count();
+        auto seconds = (double)elapsed / 1e9;
+
+        bench::Report::Row row;
+        row.emplace_back("queue", _config.queue);
+        row.emplace_back("producers", to_string(_config.producers));
+        row.emplace_back("consumers", to_string(_config.consumers));
+        row.emplace_back("capacity", to_string(_config.capacity));
+        row.emplace_back("payload", to_string(sizeof(T)));
+        row.emplace_back("messages", to_string(latency.Count()));
+        row.emplace_back("ops_per_sec", to_string((uint64_t)(seconds > 0 ? total / seconds : 0)));
+        row.emplace_back("mean_ns", to_string((uint64_t)latency.Mean()));
+        row.emplace_back("p50_ns", to_string(latency.Percentile(50.0)));
+        row.emplace_back("p99_ns", to_string(latency.Percentile(99.0)));
+        row.emplace_back("p999_ns", to_string(latency.Percentile(99.9)));
+        row.emplace_back("max_ns", to_string(latency.Max()));
+        return row;
+    }
+
+private:
+    void wait(unsigned slot) {
+        if (_config.pin) {
+            bench::PinThread(slot);
+        }
+        _ready.fetch_add(1);
+        while (!_start.load(memory_order_acquire)) {
+            this_thread::yield();
+        }
+    }
+
+    void producer(unsigned id, unsigned slot) {
+        wait(slot);
+        // split the messages evenly, the first producers take the remainder
+        auto count = _config.messages / _config.producers + (id < _config.messages % _config.producers ? 1 : 0);
+        for (size_t seq = 0; seq < count; ++seq) {
+            T node((int64_t)seq, bench::NowNs());
+            while (!QueueOps<Queue>::TryPush(_queue.get(), node)) {
+                this_thread::yield();
+            }
+        }
+    }
+
+    void consumer(unsigned id, unsigned slot) {
+        wait(slot);
+        auto &histogram = _histograms[id];
+        T node;
+        while (_popped.load(memory_order_relaxed) < _config.messages) {
+            if (QueueOps<Queue>::TryPop(_queue.get(), node)) {
+                histogram.Record(bench::NowNs() - node.ts);
+                _popped.fetch_add(1, memory_order_relaxed);
+            } else {
+                this_thread::yield();
+            }
+        }
+    }
+
+private:
+    const Config _config;
+    unique_ptr<Queue> _queue;
+
+    atomic<size_t> _ready;
+    atomic<bool> _start;
+    atomic<size_t> _popped;
+    vector<bench::Histogram> _histograms;
+};
+
+template <template <typename> class Queue, size_t N>
+void runPayload(const Config &config, bench::Report &report) {
+    QueueBench<Queue<Payload<N>>, Payload<N>> test(config);
+    report.Add(test.Run());
+}
+
+template <template <typename> class Queue>
+void runQueue(const Config &config, bench::Report &report) {
+    switch (config.payload) {
+    case 16:
+        runPayload<Queue, 16>(config, report);
+        break;
+    case 64:
+        runPayload<Queue, 64>(config, report);
+        break;
+    case 256:
+        runPayload<Queue, 256>(config, report);
+        break;
+    default:
+        printf("[Warn] unsupported payload %zu\n", config.payload);
+        break;
+    }
+}
+
+vector<unsigned> parseList(const string &text) {
+    vector<unsigned> values;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        auto end = text.find(',', begin);
+        if (end == string::npos) {
+            end = text.size();
+        }
+        values.push_back((unsigned)stoul(text.substr(begin, end - begin)));
+        begin = end + 1;
+    }
+    return values;
+}
+
+int main(int argc, char *argv[]) {
+    cmdline::parser parser;
+    parser.add<string>("queues", 'q', "queues to run", false, "spsc,mpsc,mpmc,blocking,concurrent");
+    parser.add<string>("threads", 't', "producer/consumer counts to sweep", false, "1,2,4");
+    parser.add<string>("capacity", 'c', "capacities to sweep", false, "256,4096");
+    parser.add<string>("payload", 'p', "payload sizes to sweep (16,64,256)", false, "16,64,256");
+    parser.add<size_t>("messages", 'm', "messages per run", false, 100000);
+    parser.add<string>("format", 'f', "output format (table,csv,json)", false, "table");
+    parser.add<string>("output", 'o', "output file, stdout if empty", false, "");
+    parser.add("no-pin", 0, "do not pin threads to cpus");
+    parser.parse_check(argc, argv);
+
+    auto queues = parser.get<string>("queues");
+    auto threads = parseList(parser.get<string>("threads"));
+    auto capacities = parseList(parser.get<string>("capacity"));
+    auto payloads = parseList(parser.get<string>("payload"));
+
+    bench::Report report;
+    auto sweep = [&](const string &name, bool multi_producer, bool multi_consumer,
+                     void (*run)(const Config &, bench::Report &)) {
+        if (queues.find(name) == string::npos) {
+            return;
+        }
+        for (auto producers : threads) {
+            if (!multi_producer && producers != 1) {
+                continue;
+            }
+            for (auto consumers : threads) {
+                if (!multi_consumer && consumers != 1) {
+                    continue;
+                }
+                for (auto capacity : capacities) {
+                    for (auto payload : payloads) {
+                        Config config{name,     producers, consumers, capacity, payload, parser.get<size_t>("messages"),
+                                      !parser.exist("no-pin")};
+                        run(config, report);
+                    }
+                }
+            }
+        }
+    };
+    sweep("spsc", false, false, runQueue<SPSCQueue>);
+    sweep("mpsc", true, false, runQueue<MPSCQueue>);
+    sweep("mpmc", true, true, runQueue<MPMCQueue>);
+    sweep("blocking", true, true, runQueue<BlockingQueue>);
+    sweep("concurrent", true, true, runQueue<ConcurrentQueue>);
+
+    FILE *out = stdout;
+    auto output = parser.get<string>("output");
+    if (!output.empty()) {
+        out = fopen(output.c_str(), "w");
+        if (out == nullptr) {
+            printf("open %s err %d %s\n", output.c_str(), errno, strerror(errno));
+            return -1;
+        }
+    }
+    report.Print(parser.get<string>("format"), out);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
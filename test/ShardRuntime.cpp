@@ -0,0 +1,135 @@
+#include "ShardRuntime.h"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+
+using namespace std;
+using namespace scorpion;
+
+constexpr unsigned kShards = 4;
+
+void TestCall(ShardRuntime &rt) {
+    for (unsigned idx = 0; idx < rt.Size(); ++idx) {
+        auto id = rt.Call(idx, [&rt]() { return rt.Current()->Id(); }).Get();
+        assert(id == idx);
+    }
+    printf("call done!\n");
+}
+
+void TestMesh(ShardRuntime &rt) {
+    // more than a mailbox holds, so the overflow path is taken too
+    constexpr uint64_t kMessages = 2000;
+    ShardLocal<uint64_t> received(rt);
+    atomic<uint64_t> done(0);
+    for (unsigned from = 0; from < rt.Size(); ++from) {
+        rt.SubmitTo(from, [&]() {
+            for (unsigned to = 0; to < rt.Size(); ++to) {
+                for (uint64_t n = 0; n < kMessages; ++n) {
+                    rt.SubmitTo(to, [&]() {
+                        ++received.Get();
+                        done.fetch_add(1, memory_order_relaxed);
+                    });
+                }
+            }
+        });
+    }
+    while (done.load() < kMessages * rt.Size() * rt.Size()) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    for (unsigned idx = 0; idx < rt.Size(); ++idx) {
+        auto count = rt.Call(idx, [&]() { return received.Get(); }).Get();
+        assert(count == kMessages * rt.Size());
+    }
+    printf("mesh done: %lu messages\n", (unsigned long)done.load());
+}
+
+void TestReply(ShardRuntime &rt) {
+    Promise<int> promise;
+    auto result = promise.GetFuture();
+    rt.SubmitTo(0, [&]() {
+        rt.SubmitTo(
+            1, [&rt]() { return (int)rt.Current()->Id() * 42; },
+            [&](int value) {
+                assert(rt.Current()->Id() == 0);
+                promise.SetValue(value);
+            });
+    });
+    assert(result.Get() == 42);
+    printf("reply done!\n");
+}
+
+void TestTimer(ShardRuntime &rt) {
+    atomic<int> fired(0);
+    Promise<void> promise;
+    auto finished = promise.GetFuture();
+    rt.SubmitTo(2, [&]() {
+        auto shard = rt.Current();
+        auto id = shard->AddTimer(chrono::milliseconds(10), [&]() { fired.fetch_add(1); },
+                                  chrono::milliseconds(10));
+        shard->AddTimer(chrono::milliseconds(55), [&, shard, id]() {
+            assert(shard->CancelTimer(id));
+            promise.SetValue();
+        });
+    });
+    finished.Get();
+    this_thread::sleep_for(chrono::milliseconds(50));
+    printf("timer fired %d times\n", fired.load());
+    assert(fired.load() >= 3 && fired.load() <= 6);
+}
+
+void TestPoller(ShardRuntime &rt) {
+    // the poller outlives this function
+    static atomic<int> flag(0);
+    static atomic<int> seen(0);
+    rt.Call(3, [&]() {
+          rt.Current()->AddPoller([&]() -> size_t {
+              if (flag.exchange(0) == 0) {
+                  return 0;
+              }
+              seen.fetch_add(1);
+              return 1;
+          });
+      }).Get();
+    for (int n = 0; n < 3; ++n) {
+        flag.store(1);
+        while (flag.load() != 0) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+    assert(seen.load() == 3);
+    printf("poller done!\n");
+}
+
+void TestIdle(ShardRuntime &rt) {
+    uint64_t parks = 0;
+    for (unsigned idx = 0; idx < rt.Size(); ++idx) {
+        parks += rt.At(idx).Parks();
+    }
+    auto begin = clock();
+    this_thread::sleep_for(chrono::milliseconds(300));
+    auto cpu = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+    uint64_t after = 0;
+    for (unsigned idx = 0; idx < rt.Size(); ++idx) {
+        after += rt.At(idx).Parks();
+    }
+    printf("idle cpu %.1f ms in 300 ms, %lu parks\n", cpu, (unsigned long)(after - parks));
+}
+
+int main() {
+    ShardOptions options;
+    options.name = "test";
+    ShardRuntime rt(kShards, options);
+    rt.Start();
+    TestCall(rt);
+    TestMesh(rt);
+    TestReply(rt);
+    TestTimer(rt);
+    TestPoller(rt);
+    TestIdle(rt);
+    rt.Stop();
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include "TaskGraph.h"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "StealingTaskPool.h"
+
+using namespace std;
+using namespace scorpion;
+
+constexpr unsigned kPoolSize = 4;
+constexpr unsigned kQueueLength = 1024;
+constexpr unsigned kTimeoutMs = 10000;
+
+// a -> (b, c) -> d, run many times without rebuilding
+template <typename QUEUE>
+void TestDiamond(Manager<Task, QUEUE> &pool) {
+    atomic<int> order(0);
+    int a = 0, b = 0, c = 0, d = 0;
+    TaskGraph graph;
+    auto na = graph.Emplace([&]() { a = ++order; }, "a");
+    auto nb = graph.Emplace([&]() { b = ++order; }, "b");
+    auto nc = graph.Emplace([&]() { c = ++order; }, "c");
+    auto nd = graph.WhenAll({nb, nc}, [&]() { d = ++order; }, "d");
+    graph.Precede(na, nb);
+    graph.Precede(na, nc);
+    for (int run = 0; run < 100; ++run) {
+        order = 0;
+        assert(graph.RunAndWait(pool));
+        assert(a == 1 && d == 4 && b > a && c > a);
+    }
+    graph.Dump();
+    (void)nd;
+    printf("diamond done!\n");
+}
+
+// one source fanning out to many leaves joined by a single sink
+template <typename QUEUE>
+void TestFanOut(Manager<Task, QUEUE> &pool) {
+    constexpr int kLeaves = 1000;
+    atomic<int> count(0);
+    TaskGraph graph;
+    auto source = graph.Emplace([]() {});
+    vector<TaskGraph::NodeId> leaves;
+    for (int idx = 0; idx < kLeaves; ++idx) {
+        auto leaf = graph.Emplace([&]() { count.fetch_add(1); });
+        graph.Precede(source, leaf);
+        leaves.push_back(leaf);
+    }
+    int seen = 0;
+    graph.WhenAll(leaves, [&]() { seen = count.load(); });
+    auto begin = chrono::steady_clock::now();
+    for (int run = 0; run < 10; ++run) {
+        assert(graph.RunAndWait(pool));
+        assert(seen == kLeaves * (run + 1));
+    }
+    auto cost = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - begin).count();
+    printf("fan out done: 10 runs of %d nodes in %ld us\n", kLeaves + 2, (long)cost);
+}
+
+template <typename QUEUE>
+void TestWhenAny(Manager<Task, QUEUE> &pool) {
+    atomic<int> fired(0);
+    atomic<bool> slow_done(false);
+    TaskGraph graph;
+    auto fast = graph.Emplace([]() {});
+    auto slow = graph.Emplace([&]() {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        slow_done = true;
+    });
+    bool early = false;
+    graph.WhenAny({fast, slow}, [&]() {
+        fired.fetch_add(1);
+        early = !slow_done;
+    });
+    assert(graph.RunAndWait(pool));
+    assert(fired == 1 && early && slow_done);
+    printf("when any done!\n");
+}
+
+template <typename QUEUE>
+void TestError(Manager<Task, QUEUE> &pool) {
+    bool after = false;
+    TaskGraph graph;
+    auto bad = graph.Emplace([]() { throw runtime_error("node failed"); });
+    auto next = graph.Emplace([&]() { after = true; });
+    graph.Precede(bad, next);
+    assert(!graph.RunAndWait(pool));
+    assert(!after);
+    try {
+        rethrow_exception(graph.Error());
+    } catch (runtime_error &e) {
+        printf("error passed through: %s\n", e.what());
+    }
+
+    TaskGraph cycle;
+    auto x = cycle.Emplace([]() {});
+    auto y = cycle.Emplace([]() {});
+    cycle.Precede(x, y);
+    cycle.Precede(y, x);
+    assert(!cycle.Run(pool));
+}
+
+template <typename QUEUE>
+void TestAll(Manager<Task, QUEUE> &pool) {
+    pool.Init(kPoolSize, kQueueLength, 1, kTimeoutMs);
+    TestDiamond(pool);
+    TestFanOut(pool);
+    TestWhenAny(pool);
+    TestError(pool);
+    pool.Final(true);
+}
+
+// the slow root keeps the only worker busy, the other roots time out in the queue
+template <typename QUEUE>
+void TestDropped() {
+    Manager<Task, QUEUE> pool;
+    pool.Init(1, kQueueLength, 1, 1);
+    atomic<int> ran(0);
+    TaskGraph graph;
+    vector<TaskGraph::NodeId> roots;
+    roots.push_back(graph.Emplace([&]() {
+        this_thread::sleep_for(chrono::milliseconds(20));
+        ran.fetch_add(1);
+    }));
+    for (int idx = 0; idx < 4; ++idx) {
+        roots.push_back(graph.Emplace([&]() { ran.fetch_add(1); }));
+    }
+    bool joined = false;
+    graph.WhenAll(roots, [&]() { joined = true; });
+    assert(!graph.RunAndWait(pool));
+    assert(!joined && ran.load() < 5);
+    try {
+        rethrow_exception(graph.Error());
+    } catch (runtime_error &e) {
+        printf("dropped done: %d nodes ran, %s\n", ran.load(), e.what());
+    }
+    pool.Final(true);
+}
+
+int main() {
+    {
+        printf("==== mpmc ====\n");
+        Manager<Task, MPMCQueue<Task>> pool;
+        TestAll(pool);
+    }
+    {
+        printf("==== stealing ====\n");
+        Manager<Task, WorkStealingDeque<Task *>> pool;
+        TestAll(pool);
+    }
+    TestDropped<MPMCQueue<Task>>();
+    TestDropped<WorkStealingDeque<Task *>>();
+    return 0;
+}
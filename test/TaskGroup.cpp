@@ -0,0 +1,118 @@
+#include "TaskGroup.h"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <thread>
+
+#include "StealingTaskPool.h"
+
+using namespace std;
+using namespace scorpion;
+
+constexpr unsigned kPoolSize = 2;
+constexpr unsigned kQueueLength = 1024;
+constexpr unsigned kTimeoutMs = 10000;
+constexpr long kFib = 30;
+constexpr long kCutoff = 15;
+
+long SerialFib(long n) {
+    return n < 2 ? n : SerialFib(n - 1) + SerialFib(n - 2);
+}
+
+// every level blocks on its children, a pool of two would deadlock without helping
+template <typename Pool>
+long Fib(Pool &pool, long n, unsigned uid) {
+    if (n < kCutoff) {
+        return SerialFib(n);
+    }
+    long a = 0;
+    long b = 0;
+    TaskGroup<Pool> group(pool, uid + 1);
+    group.Spawn([&]() { a = Fib(pool, n - 1, uid + 1); });
+    group.Spawn([&]() { b = Fib(pool, n - 2, uid + 1); });
+    assert(group.Wait());
+    return a + b;
+}
+
+template <typename Pool>
+void TestFib(Pool &pool, const char *name) {
+    auto begin = chrono::steady_clock::now();
+    long result = 0;
+    TaskGroup<Pool> root(pool, 0);
+    root.Spawn([&]() { result = Fib(pool, kFib, 0); });
+    assert(root.Wait());
+    auto cost = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - begin).count();
+    assert(result == SerialFib(kFib));
+    printf("%s fib(%ld) = %ld in %ld ms\n", name, kFib, result, (long)cost);
+}
+
+template <typename Pool>
+void TestError(Pool &pool, const char *name) {
+    atomic<int> ran(0);
+    TaskGroup<Pool> group(pool, 1);
+    for (int idx = 0; idx < 100; ++idx) {
+        group.Spawn([&ran, idx]() {
+            ran.fetch_add(1);
+            if (idx == 42) {
+                throw runtime_error("child failed");
+            }
+        });
+    }
+    assert(!group.Wait());
+    assert(ran.load() == 100);
+    try {
+        group.Error();
+        assert(false);
+    } catch (runtime_error &e) {
+        printf("%s error done: %s\n", name, e.what());
+    }
+}
+
+template <typename QUEUE>
+void TestManager(const char *name) {
+    Manager<Task, QUEUE> pool;
+    pool.Init(kPoolSize, kQueueLength, 1, kTimeoutMs);
+    TestFib(pool, name);
+    TestError(pool, name);
+    pool.Final(true);
+}
+
+// children on the strand the waiter holds used to never run, they run inline now
+void TestHeldStrand() {
+    Manager<Task, MPSCQueue<Task>> pool;
+    pool.Init(2, kQueueLength, 1, kTimeoutMs);
+    atomic<int> ran(0);
+    atomic<bool> done(false);
+    pool.Submit(5, Task(5, chrono::steady_clock::now(), [&]() {
+        assert(pool.Holds(5) && !pool.Holds(6));
+        TaskGroup<Manager<Task, MPSCQueue<Task>>> group(pool, 5);
+        for (int idx = 0; idx < 10; ++idx) {
+            group.Spawn([&ran]() { ran.fetch_add(1); });
+        }
+        assert(group.Wait());
+        done = true;
+        return 0;
+    }));
+    while (!done.load()) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    pool.Final(true);
+    assert(ran.load() == 10 && !pool.Holds(5));
+    printf("held strand done: %d children ran inline\n", ran.load());
+}
+
+int main() {
+    {
+        ThreadPool pool(kPoolSize);
+        TestFib(pool, "thread pool");
+        TestError(pool, "thread pool");
+    }
+    TestManager<MPMCQueue<Task>>("mpmc");
+    TestManager<MPSCQueue<Task>>("strand");
+    TestManager<WorkStealingDeque<Task *>>("stealing");
+    TestHeldStrand();
+    return 0;
+}
@@ -1,13 +1,19 @@
 #include "ThreadPool.h"
 
+#include <cassert>
+#include <chrono>
 #include <cstdio>
+#include <ctime>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace std;
 using namespace scorpion;
 
-int main() {
-    ThreadPool tp(10);
-
+void TestPush(ThreadPool &tp) {
     for (int id = 0; id < 1024; id++) {
         auto f = [=]() {
             printf(" %p -> %d\n", &id, id);
@@ -18,4 +24,70 @@ int main() {
             printf("push failed %d\n", id);
         }
     }
-}
\ No newline at end of file
+}
+
+void TestSubmit(ThreadPool &tp) {
+    vector<Future<int>> futures;
+    for (int id = 0; id < 100; id++) {
+        futures.push_back(tp.Submit([](int a, int b) { return a * b; }, id, 2));
+    }
+    for (int id = 0; id < 100; id++) {
+        assert(futures[(size_t)id].Get() == id * 2);
+    }
+
+    auto chained = tp.Submit([]() { return string("answer"); })
+                       .Then([](string s) { return s + " is"; })
+                       .Then([](string s) { return s.size(); })
+                       .Then([](size_t n) { printf("continuation got %zu\n", n); });
+    chained.Get();
+
+    auto failed = tp.Submit([]() -> int { throw runtime_error("boom"); }).Then([](int v) { return v + 1; });
+    try {
+        failed.Get();
+        assert(false);
+    } catch (runtime_error &e) {
+        printf("exception passed through: %s\n", e.what());
+    }
+
+    auto slow = tp.Submit([]() { this_thread::sleep_for(chrono::milliseconds(100)); });
+    assert(!slow.WaitFor(chrono::milliseconds(1)));
+    slow.Get();
+    printf("submit done!\n");
+}
+
+void TestMoveOnly(ThreadPool &tp) {
+    static_assert(sizeof(ThreadPool::Callback) == 64, "one cache line");
+    auto value = make_unique<int>(42);
+    auto f = tp.Submit([v = std::move(value)]() { return *v; });
+    assert(f.Get() == 42);
+
+    // too large for the inline buffer, Submit falls back to a heap wrapper
+    char big[128] = "large capture";
+    auto g = tp.Submit([big]() { return string(big); });
+    assert(g.Get() == "large capture");
+    printf("move only done!\n");
+}
+
+void TestIdle(ThreadPool &tp) {
+    auto begin = clock();
+    this_thread::sleep_for(chrono::milliseconds(500));
+    auto cpu = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+    printf("idle cpu %.1f ms in 500 ms\n", cpu);
+
+    // parked workers wake up promptly
+    auto ts = chrono::steady_clock::now();
+    auto latency = tp.Submit([ts]() {
+                         return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - ts).count();
+                     })
+                       .Get();
+    printf("wake up latency %ld us\n", (long)latency);
+}
+
+int main() {
+    ThreadPool tp(10);
+    TestPush(tp);
+    TestSubmit(tp);
+    TestMoveOnly(tp);
+    TestIdle(tp);
+    return 0;
+}
@@ -1,13 +1,100 @@
 #include "TimeWheel.h"
 
+#include <atomic>
+#include <cassert>
 #include <chrono>
 #include <ctime>
 #include <thread>
 
+#include "AsyncTaskPool.h"
+#include "ThreadPool.h"
+
 using namespace std;
 using namespace chrono;
 using namespace scorpion;
 
+void testExecutor() {
+    assert(DefaultExecutor().Concurrency() >= 2);
+    ThreadPool pool(1);
+    Manager<Task, MPMCQueue<Task>> manager;
+    manager.Init(2, 1024, 10, 1000);
+    ManagerExecutor<MPMCQueue<Task>> on_manager(manager);
+    Executor *executors[] = {&pool, &on_manager, &DefaultExecutor()};
+    for (auto executor : executors) {
+        atomic<unsigned> ran(0);
+        atomic<bool> other_thread(false);
+        auto caller = this_thread::get_id();
+        TimeWheelRaw twr(*executor);
+        twr.Add(
+            [&]() {
+                other_thread = this_thread::get_id() != caller;
+                return (int)ran.fetch_add(1);
+            },
+            1, 3);
+        // a fire due while the previous run is in flight would be skipped, let each run finish
+        for (unsigned i = 0; i < 4; ++i) {
+            twr.Tick();
+            while (ran.load() < i) {
+                this_thread::sleep_for(milliseconds(1));
+            }
+            this_thread::sleep_for(milliseconds(2));
+        }
+        assert(other_thread.load());
+    }
+    manager.Final(true);
+    printf("executor done: default executor runs %u threads\n", DefaultExecutor().Concurrency());
+}
+
+// a repeating callback slower than its interval must not overlap itself
+void testSerialized() {
+    ThreadPool pool(4);
+    atomic<int> inside(0);
+    atomic<int> worst(0);
+    atomic<int> runs(0);
+    {
+        TimeWheelRaw twr(pool);
+        twr.Add(
+            [&, state = 0]() mutable {
+                auto now = inside.fetch_add(1) + 1;
+                worst = max(worst.load(), now);
+                ++state; // the callable state is shared by every fire
+                this_thread::sleep_for(milliseconds(20));
+                inside.fetch_sub(1);
+                return (int)runs.fetch_add(1);
+            },
+            1, -1);
+        for (int i = 0; i < 20; ++i) {
+            twr.Tick();
+            this_thread::sleep_for(milliseconds(5));
+        }
+        while (inside.load() > 0) {
+            this_thread::sleep_for(milliseconds(1));
+        }
+    }
+    printf("serialized done: %d runs, at most %d at a time\n", runs.load(), worst.load());
+    assert(worst.load() == 1 && runs.load() > 1 && runs.load() < 20);
+}
+
+// the callback captures the wheel's owner, destroying the wheel must wait for it
+void testOutlive() {
+    ThreadPool pool(2);
+    atomic<bool> finished(false);
+    {
+        TimeWheelRaw twr(pool);
+        twr.Add(
+            [&]() {
+                this_thread::sleep_for(milliseconds(50));
+                finished = true;
+                return 0;
+            },
+            1, 1);
+        twr.Tick();
+        twr.Tick();
+    }
+    assert(finished.load());
+    printf("outlive done\n");
+}
+
 void testRaw() {
     TimeWheelRaw twr;
 
@@ -86,6 +173,10 @@ void test() {
 }
 
 int main() {
+    printf("===================\n");
+    testExecutor();
+    testSerialized();
+    testOutlive();
     printf("===================\n");
     testRaw();
     printf("===================\n");